@@ -1,14 +1,33 @@
 /*****************************************************************
  *  sched_attack.c  —  Attack-window analyser with string IDs
- *  build:  gcc -std=c11 -Wall -O2  sched_attack.c -o sched_attack
- *  usage:  ./sched_attack  <SampleTwo.csv>  [-i id1,id2,...]
+ *  build:  gcc -std=c11 -Wall -O2  sched_attack.c -o sched_attack -lm
+ *  usage:  ./sched_attack  <SampleTwo.csv[@offset]>  [-m log.csv[@offset]]...
+ *                          [-i id1,id2,...]
+ *                          [-v level] [-j rounds.jsonl] [-c cachedir]
+ *                          [-o results.awr] [--csv] [-f features.csv]
+ *                          [-k ckptfile [-e hyperperiods]] [--resume]
+ *                          [-p greedy|optimal] [--replay]
+ *          ./sched_attack  --export results.awr [out.csv]
+ *          ./sched_attack  <csv|->  --detect [--jitter j] [-i ids] [-j alerts.jsonl]
  *****************************************************************/
+#define _POSIX_C_SOURCE 200809L  /* getopt, open_memstream, fmemopen */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <stdarg.h>
+#include <stddef.h>   /* offsetof() */
+#include <stdint.h>   /* uint64_t payload words */
 #include <unistd.h>   /* getopt() */
+#include <getopt.h>   /* getopt_long() */
+#include <fcntl.h>    /* open() */
+#include <sys/mman.h> /* mmap() */
+#include <sys/stat.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h> /* AVX2 payload kernels, picked at run time */
+#define PAYLOAD_X86 1
+#endif
 
 /* ─── strsep shim (Windows / MinGW lacks it) ───────────── */
 #ifndef HAVE_STRSEP
@@ -88,6 +107,82 @@ int   minDlc       = 7;         /* bytes                            */
 float busSpeed     = 500;       /* kbps                             */
 const char *testID = "0x01CD";  /* for debug prints                 */
 
+/* ─────────────  reporting  ─────────────────────────────────── */
+/* Everything the analyser prints goes through a sink: a large
+   private buffer in front of a FILE*, flushed only when full or at
+   exit, so the round loop never waits on the terminal/pipe.
+   Verbosity (-v) decides what is formatted at all; the default is
+   the final summary table only.                                  */
+enum { REP_SUMMARY = 0,         /* load stats + final table       */
+       REP_ROUND   = 1,         /* one line per round             */
+       REP_CAND    = 2,         /* per candidate: pattern, policy */
+       REP_INST    = 3,         /* per instance atkWinLen/count   */
+       REP_WINDOW  = 4 };       /* full attack windows + debug    */
+
+#define SINK_BUFSZ (1 << 20)
+
+struct Sink{
+    FILE   *fp;
+    char   *buf;
+    size_t  used;
+};
+
+int         verbosity = REP_SUMMARY;
+struct Sink repSink   = {NULL, NULL, 0};   /* stdout                 */
+struct Sink jsonSink  = {NULL, NULL, 0};   /* -j: JSON-lines stream  */
+
+void SinkOpen(struct Sink *s, FILE *fp)
+{
+    s->fp   = fp;
+    s->used = 0;
+    s->buf  = malloc(SINK_BUFSZ);
+    if(!s->buf){ perror("malloc"); exit(EXIT_FAILURE); }
+}
+
+void SinkFlush(struct Sink *s)
+{
+    if(s->fp && s->used){
+        fwrite(s->buf, 1, s->used, s->fp);
+        fflush(s->fp);
+    }
+    s->used = 0;
+}
+
+void SinkClose(struct Sink *s)
+{
+    SinkFlush(s);
+    if(s->fp && s->fp != stdout) fclose(s->fp);
+    free(s->buf);
+    s->fp = NULL; s->buf = NULL;
+}
+
+void SinkPrintf(struct Sink *s, const char *fmt, ...)
+{
+    va_list ap, aq;
+    if(!s->fp) return;
+    va_start(ap, fmt);
+    va_copy(aq, ap);
+    int n = vsnprintf(s->buf + s->used, SINK_BUFSZ - s->used, fmt, ap);
+    if(n >= 0 && (size_t)n >= SINK_BUFSZ - s->used){    /* did not fit */
+        SinkFlush(s);
+        if((size_t)n < SINK_BUFSZ)
+            n = vsnprintf(s->buf, SINK_BUFSZ, fmt, aq);
+        else{                                         /* huge record */
+            vfprintf(s->fp, fmt, aq);
+            n = 0;
+        }
+    }
+    if(n > 0) s->used += n;
+    va_end(aq);
+    va_end(ap);
+}
+
+/* level test happens before any argument is formatted */
+#define REPORT(level, ...) \
+    do{ if((level) <= verbosity) SinkPrintf(&repSink, __VA_ARGS__); }while(0)
+#define JSONL(...) \
+    do{ if(jsonSink.fp) SinkPrintf(&jsonSink, __VA_ARGS__); }while(0)
+
 /* ─────────────  data structures  ───────────────────────────── */
 struct Instance{
     int   index;
@@ -96,6 +191,7 @@ struct Instance{
     int   attackable;
     int  *atkWin;
     int  *insWin;
+    int   dirty;        /* changed since the last checkpoint */
 };
 
 struct Message{
@@ -114,6 +210,9 @@ struct Message{
     int  *sortedASP;
     int  *pattern;
     int   skipLimit;
+    int  *zeroRun;      /* policy engine: zero-run index over pattern */
+    int   zeroPairs;    /*   ... and the longest run, in scan pairs   */
+    double stamp;       /* frames: capture time at full precision     */
 };
 
 /* ─────────────  helper: numeric form of an ID string  ───────── */
@@ -143,72 +242,229 @@ void InitializeECU(struct Message **S)
 }
 
 /* ------------------------------------------------------------------
-   Read one CAN log CSV (Vector-style header shown by you) into a
-   dynamically-growing array of struct Message.  Works even when some
-   data-byte columns are empty, because it uses strsep() which keeps
-   empty tokens.
+   Parse one CAN log CSV line (Vector-style header shown by you) into
+   a struct Message.  Works even when some data-byte columns are empty,
+   because it uses strsep() which keeps empty tokens.  Returns 1 for a
+   usable frame (identifier AND time present).  With data != NULL the
+   D0..D7 hex bytes are packed into *data, byte i in bits 8i..8i+7.
    ------------------------------------------------------------------ */
    #include <ctype.h>     /* isspace() */
    #include <errno.h>
-   
-int InitializeCANTraffic(struct Message **out, const char *csvFile)
+
+static int ParseCANLine(char *line, struct Message *msg, uint64_t *data)
    {
-       FILE *fp = fopen(csvFile, "r");
-       if (!fp) { perror(csvFile); return -1; }
-   
-       char  line[4096];
-       int   row = 0, used = 0;
-   
-       /* throw away the header line */
-       if (!fgets(line, sizeof line, fp)) { fclose(fp); return 0; }
-   
-       while (fgets(line, sizeof line, fp))
+       /* remove trailing CR/LF */
+       size_t len = strlen(line);
+       while (len && isspace((unsigned char)line[len-1])) line[--len] = '\0';
+
+       memset(msg, 0, sizeof *msg);
+       if (data) *data = 0;
+
+       /* split ----------------------------------------------------------------*/
+       char *save = line, *tok;
+       int   col  = 0;
+       while ((tok = strsep(&save, ",")) != NULL)
        {
-           /* remove trailing CR/LF */
-           size_t len = strlen(line);
-           while (len && isspace((unsigned char)line[len-1])) line[--len] = '\0';
-   
-           /* enlarge array and zero the freshly created struct            */
-           *out = realloc(*out, (used+1) * sizeof(**out));
-           struct Message *msg = &(*out)[used];
-           memset(msg, 0, sizeof *msg);
-   
-           /* split ----------------------------------------------------------------*/
-           char *save = line, *tok;
-           int   col  = 0;
-           while ((tok = strsep(&save, ",")) != NULL)
+           switch (col)                      /* only columns we care about  */
            {
-               switch (col)                      /* only columns we care about  */
-               {
-                    case 1:                       /* Identifier -----------------*/
-                        /* add "0x" if the token doesn’t already have it */
-                        if (tok[0]=='0' && (tok[1]=='x' || tok[1]=='X'))
-                            strncpy(msg->ID, tok, IDLEN-1);        /* already has 0x */
-                        else
-                            snprintf(msg->ID, IDLEN, "0x%s", tok); /* prepend 0x     */
-                        msg->ID[IDLEN-1] = '\0';
-                        break;
-   
-                   case 2:                       /* DLC ------------------------*/
-                       /* defensive: empty DLC ⇒ 0                                */
-                       msg->DLC = (*tok) ? atoi(tok) : 0;
-                       break;
-   
-                   case 11:                      /* Time -----------------------*/
-                       msg->txTime = strtof(tok, NULL);
-                       break;
-               }
-               ++col;
+                case 1:                       /* Identifier -----------------*/
+                    /* add "0x" if the token doesn’t already have it */
+                    if (tok[0]=='0' && (tok[1]=='x' || tok[1]=='X'))
+                        strncpy(msg->ID, tok, IDLEN-1);        /* already has 0x */
+                    else
+                        snprintf(msg->ID, IDLEN, "0x%s", tok); /* prepend 0x     */
+                    msg->ID[IDLEN-1] = '\0';
+                    break;
+
+               case 2:                       /* DLC ------------------------*/
+                   /* defensive: empty DLC ⇒ 0                                */
+                   msg->DLC = (*tok) ? atoi(tok) : 0;
+                   break;
+
+               case 3: case 4: case 5: case 6:   /* D0..D7 -------------------*/
+               case 7: case 8: case 9: case 10:
+                   if (data && *tok)
+                       *data |= (uint64_t)(strtoul(tok, NULL, 16) & 0xFF) << (8*(col-3));
+                   break;
+
+               case 11:                      /* Time -----------------------*/
+                   msg->txTime = strtof(tok, NULL);
+                   msg->stamp  = strtod(tok, NULL);
+                   break;
            }
-   
-           /* basic sanity – ignore lines without identifier OR time -------------*/
-           if (msg->ID[0] && msg->txTime > 0.0f)
-               ++used;
+           ++col;
        }
-       fclose(fp);
-       return used;           /* number of packets successfully parsed */
+
+       /* basic sanity – ignore lines without identifier OR time -------------*/
+       return msg->ID[0] && msg->txTime > 0.0f;
    }
-   
+
+/* ------------------------------------------------------------------
+   Multi-log input.  Rotated logs and captures of the same bus taken
+   by separate interfaces are merged by timestamp with a k-way heap
+   merge: each file is read line by line, only the current frame of
+   every file is held, and the merged stream goes straight into the
+   frame table.  The analysis and --replay walk that table back and
+   forth, so it holds the merged trace once; --detect consumes the
+   stream directly and stores nothing.  "file@offset" shifts a
+   file's clock by offset s.
+   Each file must be time-sorted on its own; ties keep file order.
+   ------------------------------------------------------------------ */
+#define MAX_LOGS 32
+
+struct LogSource{
+    const char *path;
+    double      offset;         /* s, added to every timestamp     */
+};
+
+struct LogReader{
+    FILE          *fp;
+    int            src;         /* index into the source list      */
+    struct Message cur;         /* next frame of this file         */
+    uint64_t       data;        /* ... and its payload             */
+    double         last;        /* time of the previous frame      */
+    long           unsorted;    /* frames older than their predecessor */
+};
+
+struct LogSource logSrc[MAX_LOGS];
+int              logCount = 0;
+
+/* "path" or "path@offset"; a suffix that is not wholly a number
+   belongs to the path ("x@y/l.csv" is a file name)                 */
+void AddLogSource(char *spec)
+{
+    if (logCount == MAX_LOGS) { fprintf(stderr, "too many logs (max %d)\n", MAX_LOGS); return; }
+    char *at = strrchr(spec, '@'), *end = NULL;
+    double off = at && at[1] ? strtod(at + 1, &end) : 0;
+    logSrc[logCount].offset = 0;
+    if (end && end != at + 1 && *end == '\0'){
+        *at = '\0';
+        logSrc[logCount].offset = off;
+    }
+    logSrc[logCount++].path = spec;
+}
+
+/* advance r to its next usable frame; 0 at end of file */
+static int LogReaderNext(struct LogReader *r, const struct LogSource *src, int keep)
+{
+    char line[4096];
+    while (fgets(line, sizeof line, r->fp))
+        if (ParseCANLine(line, &r->cur, keep ? &r->data : NULL)){
+            if (src[r->src].offset != 0){
+                r->cur.stamp += src[r->src].offset;
+                r->cur.txTime = (float)r->cur.stamp;
+            }
+            if (r->cur.stamp < r->last) r->unsorted++;
+            r->last = r->cur.stamp;
+            return 1;
+        }
+    return 0;
+}
+
+/* on stamp: at trace-scale times a float cannot separate frames ms apart */
+static int LogBefore(const struct LogReader *a, const struct LogReader *b)
+{
+    if (a->cur.stamp != b->cur.stamp) return a->cur.stamp < b->cur.stamp;
+    return a->src < b->src;
+}
+
+static void HeapDown(struct LogReader **heap, int n, int i)
+{
+    for (;;){
+        int l = 2*i + 1, m = i;
+        if (l     < n && LogBefore(heap[l],   heap[m])) m = l;
+        if (l + 1 < n && LogBefore(heap[l+1], heap[m])) m = l + 1;
+        if (m == i) return;
+        struct LogReader *t = heap[i]; heap[i] = heap[m]; heap[m] = t;
+        i = m;
+    }
+}
+
+/* the merge as an iterator: LogMergeNext() hands out one frame at a
+   time, so a consumer can work on the stream without storing it    */
+struct LogMerge{
+    struct LogReader        *rd;
+    struct LogReader       **heap;
+    const struct LogSource  *src;
+    int                      k, n, keep, opened;
+};
+
+int LogMergeOpen(struct LogMerge *m, const struct LogSource *src, int k, int keepPayload)
+{
+    char line[4096];
+    m->rd   = calloc(k, sizeof *m->rd);
+    m->heap = malloc(k * sizeof *m->heap);
+    if (!m->rd || !m->heap) { perror("malloc"); exit(EXIT_FAILURE); }
+    m->src = src; m->k = k; m->n = 0; m->keep = keepPayload; m->opened = 0;
+
+    for (int f = 0; f < k; f++){
+        m->rd[f].src = f;
+        m->rd[f].fp  = strcmp(src[f].path, "-") == 0 ? stdin : fopen(src[f].path, "r");
+        if (!m->rd[f].fp) { perror(src[f].path); continue; }
+        m->opened++;
+        /* throw away the header line */
+        if (fgets(line, sizeof line, m->rd[f].fp) && LogReaderNext(&m->rd[f], src, keepPayload))
+            m->heap[m->n++] = &m->rd[f];
+    }
+    for (int i = m->n/2 - 1; i >= 0; i--) HeapDown(m->heap, m->n, i);
+    return m->opened;
+}
+
+/* next frame in time order (and its payload if kept); 0 when all are done */
+int LogMergeNext(struct LogMerge *m, struct Message *msg, uint64_t *data)
+{
+    if (m->n == 0) return 0;
+    *msg = m->heap[0]->cur;
+    if (data) *data = m->heap[0]->data;
+    if (!LogReaderNext(m->heap[0], m->src, m->keep)) m->heap[0] = m->heap[--m->n];
+    HeapDown(m->heap, m->n, 0);
+    return 1;
+}
+
+void LogMergeClose(struct LogMerge *m)
+{
+    for (int f = 0; f < m->k; f++){
+        if (!m->rd[f].fp) continue;
+        if (m->rd[f].unsorted)
+            fprintf(stderr, "%s: %ld frame(s) out of time order\n",
+                    m->src[f].path, m->rd[f].unsorted);
+        if (m->rd[f].fp != stdin) fclose(m->rd[f].fp);
+    }
+    free(m->rd); free(m->heap);
+}
+
+/* payload != NULL also fills *payload, one packed D0..D7 word per frame */
+int InitializeCANTrafficMerged(struct Message **out, uint64_t **payload,
+                               const struct LogSource *src, int k)
+{
+    struct LogMerge m;
+    int used = 0, cap = 0;
+    int opened = LogMergeOpen(&m, src, k, payload != NULL);
+
+    for (;;){
+        if (used == cap){
+            cap = cap ? 2*cap : 4096;
+            *out = realloc(*out, cap * sizeof **out);
+            if (!*out) { perror("realloc"); exit(EXIT_FAILURE); }
+            if (payload){
+                *payload = realloc(*payload, cap * sizeof **payload);
+                if (!*payload) { perror("realloc"); exit(EXIT_FAILURE); }
+            }
+        }
+        if (!LogMergeNext(&m, &(*out)[used], payload ? &(*payload)[used] : NULL)) break;
+        used++;
+    }
+    LogMergeClose(&m);
+    return opened ? used : -1;     /* number of packets successfully parsed */
+}
+
+/* Read one CAN log CSV into a dynamically-growing array of struct Message. */
+int InitializeCANTraffic(struct Message **out, const char *csvFile)
+{
+    struct LogSource one = {csvFile, 0};
+    return InitializeCANTrafficMerged(out, NULL, &one, 1);
+}
+
 
 // merge two sorted arrays
 void IntMerge(int *arr, int *temp, int l, int m, int r)
@@ -508,6 +764,7 @@ void CommonMessages(int *a, int *x, int n_a, int *b, int *y, int n_b, struct Ins
     free((*ins).atkWin);
     PRINT("\n In common: freeing insWin");
     free((*ins).insWin);
+    (*ins).atkWin = (*ins).insWin = NULL;      /* empty intersection */
     (*ins).atkWinCount = atkWinCount;
     PRINT("\n In Common: atkWinCount = %d",atkWinCount);
     if(atkWinCount>0)
@@ -534,34 +791,94 @@ int GetCurrentInstance(struct Message **cand, const char *id)
     return -1;
 }
 
-void AnalyzeCANTraffic(struct Message *CANTraffic, int CANCount, struct Message **candidates)
+/* Set while the cached first pass runs: tInsWin then records the
+   sender's same-ID frame ordinal (independent of the -i subset)
+   instead of its current instance number, see RebaseInsWin().     */
+int *frameOrd = NULL;
+
+/* --replay: mask/offset overlay over the loaded trace, see the
+   replay section below.  While set, the analysis skips masked frames,
+   shifts the survivors earlier and maps each frame to the instance
+   slot it had in the original trace.                               */
+struct Replay{
+    int           *ord;         /* same-ID ordinal of every frame     */
+    int           *owner;       /* candidate position, -1 if none     */
+    unsigned char *drop;        /* 1 = frame skipped by its pattern   */
+};
+struct Replay *replay = NULL;
+int ReplayNext(struct Message *T, int CANCount, int j, float endAt, float *busy, float *start);
+
+/* -k: incremental checkpoint log, see the checkpoint section below */
+struct Checkpoint{
+    const char *path;
+    FILE  *fp;                  /* base snapshot + appended deltas    */
+    int    every;               /* hyper-periods of trace per delta   */
+    int    resumeFrame;         /* first frame of the (resumed) pass  */
+    double nextAt;              /* trace time of the next delta       */
+    unsigned long long traceHash;
+};
+struct Checkpoint ckpt = {NULL, NULL, 4, 0, 0, 0};
+void CheckpointDelta(struct Message *c, int n, int frame);
+
+void AnalyzeCANTraffic(struct Message *CANTraffic, int CANCount, struct Message **candidates, int nCand)
 {
     int j=0,i=0,k=0,l=0,insNo = 0;
     float txStart = 0, txEnds = 0, nextTxStart = 0;
     float maxIdle = (minDlc*8+47)/(busSpeed*1000);
     struct Message CANPacket, candidate;
+    float rpStart = 0, rpBusy = 0;              /* replay: shifted times */
+    long *idEcuArr = malloc(nCand * sizeof *idEcuArr);   /* parsed once */
+    if (!idEcuArr) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (i = 0; i < nCand; i++) idEcuArr[i] = id_to_long((*candidates)[i].ID);
+    j = ckpt.resumeFrame;
+    ckpt.resumeFrame = 0;
+    if (ckpt.fp) ckpt.nextAt = CANTraffic[j].txTime + (double)ckpt.every*h;
+    if (replay)
+    {
+        while (j < CANCount && replay->drop[j]) j++;
+        if (j < CANCount) rpStart = rpBusy = CANTraffic[j].txTime;
+    }
     while(j<CANCount-1)
     {
+        int next = j + 1;
         CANPacket = CANTraffic[j];
+        if (ckpt.fp && CANPacket.txTime >= ckpt.nextAt)
+        {
+            CheckpointDelta(*candidates, nCand, j);
+            ckpt.nextAt = CANPacket.txTime + (double)ckpt.every*h;
+        }
         txStart = CANPacket.txTime;
         long idPkt = id_to_long(CANPacket.ID);
         txEnds = ((CANPacket.DLC)*8 + 47)/(busSpeed*1000);
         nextTxStart = CANTraffic[j+1].txTime;
+        if (replay)
+        {
+            next = ReplayNext(CANTraffic, CANCount, j, rpStart + txEnds, &rpBusy, &nextTxStart);
+            if (next >= CANCount) break;
+            txStart = rpStart;
+            rpStart = nextTxStart;
+        }
         PRINT("\n Checking for CAN ID (%d):%d ***********************",j,CANPacket.ID);
-        for(i=0;i<ECUCountVar;i++)
+        int owner = -1;            /* what GetCurrentInstance() would look up */
+        for(i=0;i<nCand && owner<0;i++)
+            if(strcmp((*candidates)[i].ID,CANPacket.ID)==0) owner = i;
+        for(i=0;i<nCand;i++)
         {
-            long idEcu = id_to_long((*candidates)[i].ID);          /* NEW */
+            long idEcu = idEcuArr[i];
             PRINT("\n Checking ECU ID:%s ***********************",(*candidates)[i].ID);
             k = 0;
+            if (replay) // skipped instances are simply absent from the trace
+                k = replay->ord[j] - (*candidates)[i].readCount;
+            else
             for (l = (*candidates)[i].readCount; l < (*candidates)[i].count; l++)
             {
                 if((*candidates)[i].pattern[l]==0)
                     k++;
             }
-            if (idEcu == id_to_long(testID))
+            if (verbosity >= REP_WINDOW && idEcu == id_to_long(testID))
             {
-                printf("\n max idle time=%f",maxIdle);
-                printf("\n gap = %f",(nextTxStart - (txStart + txEnds)));
+                REPORT(REP_WINDOW, "\n max idle time=%f",maxIdle);
+                REPORT(REP_WINDOW, "\n gap = %f",(nextTxStart - (txStart + txEnds)));
             }
             if((idPkt > idEcu) || ((nextTxStart-(txStart+txEnds))>maxIdle && (idPkt != idEcu))) // If CAN packet is of lower priority or there is an idle period in between
             {
@@ -577,7 +894,8 @@ void AnalyzeCANTraffic(struct Message *CANTraffic, int CANCount, struct Message
             }
             else if(idPkt < idEcu)
             {
-                insNo = GetCurrentInstance(candidates,CANPacket.ID);
+                insNo = frameOrd ? frameOrd[j]
+                      : owner >= 0 ? (*candidates)[owner].readCount : -1;
                 // what is instance no. of the CANPacket if it is coming from target ECU
                 (*candidates)[i].tAtkWinCount = (*candidates)[i].tAtkWinCount + 1;
                 (*candidates)[i].tAtkWinLen = (*candidates)[i].tAtkWinLen + (CANPacket.DLC)*8 + 47;
@@ -635,6 +953,8 @@ void AnalyzeCANTraffic(struct Message *CANTraffic, int CANCount, struct Message
                     }
                 }
 
+                (*candidates)[i].instances[((*candidates)[i].readCount+k)%(*candidates)[i].count].dirty = 1;
+
                 if((*candidates)[i].tAtkWinLen>0)
                 {
                     PRINT("\n freeing tAtkWin at end");
@@ -647,63 +967,480 @@ void AnalyzeCANTraffic(struct Message *CANTraffic, int CANCount, struct Message
                 (*candidates)[i].readCount=(*candidates)[i].readCount+k+1;
             }
         }
-        j++;
+        j = next;
     }
+    free(idEcuArr);
 }
 
-// This function checks if a new skip is introduced in the existing pattern
-// the CLF criteria is violated or not.
-int IfSkipPossible(int *patternList, int patternLen, int skipLimit, int newSkipPosition)
+/* ─────────────  obfuscation policy engine  ─────────────────── */
+/* Indexed policy checks.  A skip is allowed (the CLF criterion)
+   while a circular scan of the pattern finds fewer than skipLimit
+   adjacent skip pairs in a row.
+     - zeroRun[] keeps, for every run of skips in pattern, run[first]
+       = last and run[last] = first, so that check is an O(1) merge
+       of the two neighbouring runs;
+     - a sorted ID → position table replaces a linear search of the
+       attack window per higher-priority candidate: one pass over
+       the window lists every candidate it contains;
+     - grpStart[] holds the start of each equal-period block for
+       policy 3 (a policy-3 swap never changes the period sequence). */
+struct IdPos{
+    long id;
+    int  pos;
+};
+
+struct PolicyEngine{
+    int           n;
+    struct IdPos *idx;      /* (ID, position in cand[]), sorted by ID  */
+    int          *grpStart; /* first position of the equal-period run  */
+    int          *seen;     /* per position: last query that hit it    */
+    int          *hitPos;   /* candidates found in the queried window  */
+    int          *hitSlot;  /* per position: first occurrence in it    */
+    int           query;
+};
+
+/* Adjacent skip pairs the circular CLF scan counts for
+   the run [s,e]: r-1 for a run of r, r if it ends the pattern while
+   pattern[0] is a skip (the wrap pair), len if every slot is a skip. */
+static int RunPairs(const int *p, int len, int s, int e)
 {
-    int i=0, sum=0;
-    patternList[newSkipPosition] = 0;
+    int r = e - s + 1;
+    if (r == len)                   return len;
+    if (e == len - 1 && !p[0])      return r;
+    return r - 1;
+}
 
-    for(i=0;i<patternLen;i++)
-    {
-        if(patternList[i%patternLen]==patternList[(i+1)%patternLen] && patternList[i%patternLen]==0)
-            sum = sum + 1;
-        else
-            sum = 0;
-        if(sum>=skipLimit)
-        {
-            patternList[newSkipPosition] = 1;
-            return 0;
-        }
+static void ZeroRunBuild(struct Message *m)
+{
+    if (!m->zeroRun){
+        m->zeroRun = malloc(m->count * sizeof(int));
+        if (!m->zeroRun) { perror("malloc"); exit(EXIT_FAILURE); }
+    }
+    m->zeroPairs = 0;
+    for (int s = 0, e; s < m->count; s = e + 1){
+        e = s;
+        if (m->pattern[s]) continue;
+        while (e + 1 < m->count && !m->pattern[e+1]) e++;
+        m->zeroRun[s] = e;
+        m->zeroRun[e] = s;
+        int pairs = RunPairs(m->pattern, m->count, s, e);
+        if (pairs > m->zeroPairs) m->zeroPairs = pairs;
     }
+}
 
+/* CLF check in O(1): placing a skip only merges the runs left
+   and right of it (and, at slot 0, adds the wrap pair of the tail
+   run), so the longest run is the old one or one of those two.
+   Returns 1 for a new skip, 2 for a slot that is already skipped
+   (accepted as it stands, pattern unchanged), 0 if refused.        */
+int IfSkipPossibleIdx(struct Message *m, int skipLimit, int x)
+{
+    int len = m->count, *p = m->pattern;
+    if (x < 0 || x >= len || skipLimit <= 0) return 0;
+    if (!m->zeroRun) ZeroRunBuild(m);
+    if (!p[x]) return 2;
+
+    int s = (x > 0       && !p[x-1]) ? m->zeroRun[x-1] : x;
+    int e = (x + 1 < len && !p[x+1]) ? m->zeroRun[x+1] : x;
+    int maxPairs = m->zeroPairs;
+
+    p[x] = 0;
+    int pairs = RunPairs(p, len, s, e);
+    if (pairs > maxPairs) maxPairs = pairs;
+    if (x == 0 && e != len - 1 && !p[len-1]){
+        pairs = RunPairs(p, len, m->zeroRun[len-1], len - 1);
+        if (pairs > maxPairs) maxPairs = pairs;
+    }
+    if (maxPairs >= skipLimit){
+        p[x] = 1;
+        return 0;
+    }
+    m->zeroRun[s] = e;
+    m->zeroRun[e] = s;
+    m->zeroPairs  = maxPairs;
     return 1;
 }
 
+static int CmpIdPos(const void *a, const void *b)
+{
+    const struct IdPos *x = a, *y = b;
+    if (x->id != y->id) return (x->id > y->id) - (x->id < y->id);
+    return x->pos - y->pos;
+}
 
-// This function checks if 'item' belongs to attack window 'atkWin'
-// ** we have to see which instance of higher priority task belongs to atkWin
-int CheckMembership(int *atkWin, int atkWinLen, int item)
+/* first table entry carrying id, or -1 */
+static int FirstOf(const struct PolicyEngine *pe, long id)
 {
-    int i=0;
+    int l = 0, r = pe->n - 1, hit = -1;
+    while (l <= r){
+        int m = l + (r - l) / 2;
+        if (pe->idx[m].id >= id){ if (pe->idx[m].id == id) hit = m; r = m - 1; }
+        else l = m + 1;
+    }
+    return hit;
+}
 
-    for(i=0;i<atkWinLen;i++)
-    {
-        if(atkWin[i] == item)
-            return i;
+void PolicyEngineInit(struct PolicyEngine *pe, int n)
+{
+    memset(pe, 0, sizeof *pe);
+    pe->n        = n;
+    pe->idx      = malloc(n * sizeof *pe->idx);
+    pe->grpStart = malloc(n * sizeof(int));
+    pe->seen     = calloc(n, sizeof(int));
+    pe->hitPos   = malloc(n * sizeof(int));
+    pe->hitSlot  = malloc(n * sizeof(int));
+    if (!pe->idx || !pe->grpStart || !pe->seen || !pe->hitPos || !pe->hitSlot){
+        perror("malloc"); exit(EXIT_FAILURE);
     }
+}
 
-    return -1;
+void PolicyEngineFree(struct PolicyEngine *pe)
+{
+    free(pe->idx); free(pe->grpStart);
+    free(pe->seen); free(pe->hitPos); free(pe->hitSlot);
+}
+
+/* per round, before the policies run: ID table and period blocks */
+void PolicyEngineBuild(struct PolicyEngine *pe, struct Message *c)
+{
+    for (int i = 0; i < pe->n; i++){
+        pe->idx[i].id  = id_to_long(c[i].ID);
+        pe->idx[i].pos = i;
+        pe->grpStart[i] = (i > 0 && c[i].periodicity == c[i-1].periodicity)
+                        ? pe->grpStart[i-1] : i;
+    }
+    qsort(pe->idx, pe->n, sizeof *pe->idx, CmpIdPos);
+}
+
+static void MovePos(struct PolicyEngine *pe, long id, int from, int to)
+{
+    for (int q = FirstOf(pe, id); q >= 0 && q < pe->n && pe->idx[q].id == id; q++)
+        if (pe->idx[q].pos == from) { pe->idx[q].pos = to; return; }
 }
 
+/* policy 3: exchange two candidates, keeping the ID table current */
+void PolicySwap(struct PolicyEngine *pe, struct Message *c, int i, int k)
+{
+    long idI = id_to_long(c[i].ID), idK = id_to_long(c[k].ID);
+    struct Message temp = c[k];
+    c[k] = c[i];
+    c[i] = temp;
+    MovePos(pe, idI, i, -1);
+    MovePos(pe, idK, k, i);
+    MovePos(pe, idI, -1, k);
+}
+
+static int CmpInt(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Candidates at positions < below that appear in the window, in
+   ascending position order; hitSlot[pos] is the first occurrence,
+   i.e. the window index of that candidate's first frame.          */
+int PolicyWindowHits(struct PolicyEngine *pe, const int *atkWin, int cnt, int below)
+{
+    int nHit = 0;
+    pe->query++;
+    for (int q = 0; q < cnt; q++)
+        for (int k = FirstOf(pe, atkWin[q]); k >= 0 && k < pe->n && pe->idx[k].id == atkWin[q]; k++){
+            int pos = pe->idx[k].pos;
+            if (pos >= below || pe->seen[pos] == pe->query) continue;
+            pe->seen[pos]      = pe->query;
+            pe->hitSlot[pos]   = q;
+            pe->hitPos[nHit++] = pos;
+        }
+    qsort(pe->hitPos, nHit, sizeof(int), CmpInt);
+    return nHit;
+}
+/* ─────────────  optimal skip-pattern solver (-p optimal)  ──── */
+/* The greedy policies skip at most one instance per candidate and
+   round.  The solver picks, per candidate, the skip set covering the
+   most attackable instances that the CLF criterion still accepts:
+   every run of skips at most skipLimit long, the run ending the
+   pattern one shorter when slot 0 is skipped (its wrap pair).  Only
+   attackable slots are worth skipping, so this is a run-length DP,
+   O(count * skipLimit) per candidate; the two cases for slot 0 cover
+   the circular wrap.  It solves on the unobfuscated attackability
+   (round 0); ApplySolver() replays both policies' patterns and keeps
+   the solver's only when they leave fewer attackable instances.     */
+enum { POLICY_GREEDY = 0, POLICY_OPTIMAL = 1 };
+int policyMode = POLICY_GREEDY;
+
+static double NowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* best pattern for one head case: head = 1 keeps slot 0, head = 0
+   skips it.  Returns the number of skips, -1 if the case is infeasible */
+static int SolveCase(const int *att, int n, int L, int head, int *out,
+                     int *dp, int *nx, int *choice)
+{
+    const int NEG = -1;
+    int W = L + 1;
+    for (int r = 0; r < W; r++) dp[r] = NEG;
+    if (head) dp[0] = 0;
+    else if (att[0] && L >= 1) { dp[1] = 1; choice[W + 1] = 1; }
+    else return -1;
+
+    for (int t = 1; t < n; t++){
+        int *ch = choice + (size_t)(t + 1) * W;
+        for (int r = 0; r < W; r++) nx[r] = NEG;
+        for (int r = 0; r < W; r++){
+            if (dp[r] == NEG) continue;
+            if (dp[r] > nx[0] || nx[0] == NEG){ nx[0] = dp[r]; ch[0] = r << 1; }
+            if (att[t] && r + 1 <= L && dp[r] + 1 > nx[r+1]){
+                nx[r+1] = dp[r] + 1;
+                ch[r+1] = r << 1 | 1;
+            }
+        }
+        memcpy(dp, nx, W * sizeof(int));
+    }
+
+    /* the run that ends the pattern wraps onto a skipped slot 0 */
+    int best = -1, rEnd = 0, cap = head ? L : L - 1;
+    for (int r = 0; r <= cap && r < W; r++)
+        if (dp[r] > best){ best = dp[r]; rEnd = r; }
+    if (best < 0) return -1;
+
+    for (int t = n - 1, r = rEnd; t >= 1; t--){
+        int c = choice[(size_t)(t + 1) * W + r];
+        out[t] = !(c & 1);
+        r = c >> 1;
+    }
+    out[0] = head;
+    return best;
+}
+
+/* optimal pattern for m written to pattern[]; returns skips used */
+int SolveSkipPattern(const struct Message *m, int *pattern)
+{
+    int n = m->count, L = m->skipLimit;
+    for (int t = 0; t < n; t++) pattern[t] = 1;
+    if (L <= 0 || n == 0) return 0;
+    if (L > n) L = n + 1;                  /* no run is longer than n */
+    int W = L + 1;
+
+    int *att  = calloc(n, sizeof(int));
+    int *alt  = malloc(n * sizeof(int));
+    int *dp   = malloc(W * sizeof(int));
+    int *nx   = malloc(W * sizeof(int));
+    int *choice = calloc((size_t)(n + 1) * W, sizeof(int));
+    if (!att || !alt || !dp || !nx || !choice) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (int j = 0; j < n; j++)
+        if (m->instances[j].attackable) att[m->instances[j].index] = 1;
+
+    int keep = SolveCase(att, n, L, 1, pattern, dp, nx, choice);
+    int skip = SolveCase(att, n, L, 0, alt, dp, nx, choice);
+    if (keep < 0) keep = 0;
+    if (skip > keep){
+        memcpy(pattern, alt, n * sizeof(int));
+        keep = skip;
+    }
+    free(att); free(alt); free(dp); free(nx); free(choice);
+    return keep;
+}
 
 /* ─────────────  CSV writers (use %s)  ───────────────────────── */
-void SaveFinalCandidatesCSV(struct Message *c,int n){
-    FILE *f=fopen("final_candidates.csv","w");
+/* ─────────────  columnar results (final_candidates.awr)  ───── */
+/* One file per run, one column after another, every column 8-byte
+   aligned so a reader can mmap the file and take typed pointers:
+
+     per candidate   ID char[IDLEN], periodicity f32,
+                     first i64[nCand+1]   (its instance rows)
+     per instance    candidate i32, instance i32, attackable u8,
+                     atkWinLen i32, atkWinCount i32,
+                     winOff i64[nIns+1]   (its window entries)
+     per window      atkWin i32, insWin i32
+
+   Candidate i is rows first[i]..first[i+1], ranked by atkWinLen;
+   instance is the row's slot in the hyper period.  Row r's windows
+   are atkWin[winOff[r]..winOff[r+1]].  Host byte order.           */
+#define RES_MAGIC 0x32525741u             /* "AWR2" */
+
+enum { RC_ID, RC_PERIOD, RC_FIRST, RC_CAND, RC_INST, RC_ATTACKABLE,
+       RC_ATKWINLEN, RC_ATKWINCOUNT, RC_WINOFF, RC_ATKWIN, RC_INSWIN,
+       RC_COLS };
+
+struct ResHdr{
+    unsigned  magic;
+    int       nCand;
+    long long nIns;
+    long long nWin;
+    int       h;
+    int       minAtkWinLen;
+    int       rounds;
+    int       pad;
+    long long colOff[RC_COLS];            /* byte offset of each column */
+};
+
+struct Results{
+    void                *map;
+    size_t               size;
+    const struct ResHdr *hd;
+    const char          *id;              /* nCand x IDLEN */
+    const float         *period;
+    const long long     *first, *winOff;
+    const int           *cand, *inst, *atkWinLen, *atkWinCount, *atkWin, *insWin;
+    const unsigned char *attackable;
+};
+
+/* write a column (p NULL: already written) and pad it to 8 bytes */
+static void ResColumn(FILE *fp, const void *p, size_t bytes)
+{
+    static const char zero[8];
+    if (p && bytes) fwrite(p, 1, bytes, fp);
+    fwrite(zero, 1, (8 - bytes % 8) % 8, fp);
+}
+
+int SaveResults(const char *path, struct Message *c, int n, int rounds)
+{
+    struct ResHdr hd;
+    long long nIns = 0, nWin = 0;
+    for (int i = 0; i < n; i++){
+        nIns += c[i].count;
+        for (int j = 0; j < c[i].count; j++) nWin += c[i].instances[j].atkWinCount;
+    }
+
+    size_t width[RC_COLS] = {
+        [RC_ID] = (size_t)n*IDLEN, [RC_PERIOD] = n*sizeof(float),
+        [RC_FIRST] = (n+1)*sizeof(long long),
+        [RC_CAND] = nIns*sizeof(int), [RC_INST] = nIns*sizeof(int),
+        [RC_ATTACKABLE] = nIns, [RC_ATKWINLEN] = nIns*sizeof(int),
+        [RC_ATKWINCOUNT] = nIns*sizeof(int), [RC_WINOFF] = (nIns+1)*sizeof(long long),
+        [RC_ATKWIN] = nWin*sizeof(int), [RC_INSWIN] = nWin*sizeof(int) };
+    memset(&hd, 0, sizeof hd);
+    hd.magic = RES_MAGIC; hd.nCand = n; hd.nIns = nIns; hd.nWin = nWin;
+    hd.h = h; hd.minAtkWinLen = minAtkWinLen; hd.rounds = rounds;
+    long long off = sizeof hd;
+    for (int k = 0; k < RC_COLS; k++){
+        hd.colOff[k] = off;
+        off += (width[k] + 7) / 8 * 8;
+    }
+
+    /* gather the columns; the window columns are streamed per instance */
+    char          *id     = calloc(n ? n : 1, IDLEN);
+    float         *period = malloc((n ? n : 1) * sizeof *period);
+    long long     *first  = malloc((n+1) * sizeof *first);
+    long long     *winOff = malloc((nIns+1) * sizeof *winOff);
+    int           *col[4];                 /* cand, inst, atkWinLen, atkWinCount */
+    unsigned char *att    = malloc(nIns ? nIns : 1);
+    for (int k = 0; k < 4; k++) col[k] = malloc((nIns ? nIns : 1) * sizeof(int));
+    if (!id || !period || !first || !winOff || !att || !col[0] || !col[1] || !col[2] || !col[3])
+        { perror("malloc"); exit(EXIT_FAILURE); }
+    long long r = 0;
+    first[0] = winOff[0] = 0;
+    for (int i = 0; i < n; i++){
+        memcpy(id + (size_t)i*IDLEN, c[i].ID, IDLEN);
+        period[i] = c[i].periodicity;
+        for (int j = 0; j < c[i].count; j++, r++){
+            const struct Instance *in = &c[i].instances[j];
+            col[0][r] = i;              col[1][r] = in->index;
+            col[2][r] = in->atkWinLen;  col[3][r] = in->atkWinCount;
+            att[r]    = in->attackable != 0;
+            winOff[r+1] = winOff[r] + in->atkWinCount;
+        }
+        first[i+1] = r;
+    }
+
+    int ok = 0;
+    FILE *fp = fopen(path, "wb");
+    if (!fp) perror(path);
+    else{
+        fwrite(&hd, sizeof hd, 1, fp);
+        ResColumn(fp, id,     width[RC_ID]);
+        ResColumn(fp, period, width[RC_PERIOD]);
+        ResColumn(fp, first,  width[RC_FIRST]);
+        ResColumn(fp, col[0], width[RC_CAND]);
+        ResColumn(fp, col[1], width[RC_INST]);
+        ResColumn(fp, att,    width[RC_ATTACKABLE]);
+        ResColumn(fp, col[2], width[RC_ATKWINLEN]);
+        ResColumn(fp, col[3], width[RC_ATKWINCOUNT]);
+        ResColumn(fp, winOff, width[RC_WINOFF]);
+        for (int w = 0; w < 2; w++){           /* atkWin, then insWin */
+            for (int i = 0; i < n; i++)
+                for (int j = 0; j < c[i].count; j++){
+                    const struct Instance *in = &c[i].instances[j];
+                    if (in->atkWinCount > 0)
+                        fwrite(w ? in->insWin : in->atkWin, sizeof(int), in->atkWinCount, fp);
+                }
+            ResColumn(fp, NULL, width[w ? RC_INSWIN : RC_ATKWIN]);
+        }
+        ok = fclose(fp) == 0;
+        if (!ok) perror(path);
+    }
+    free(id); free(period); free(first); free(winOff); free(att);
+    for (int k = 0; k < 4; k++) free(col[k]);
+    return ok;
+}
+
+int ResultsOpen(const char *path, struct Results *rs)
+{
+    struct stat st;
+    memset(rs, 0, sizeof *rs);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return 0; }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct ResHdr)){
+        fprintf(stderr, "%s: not a results file\n", path);
+        close(fd); return 0;
+    }
+    rs->size = st.st_size;
+    rs->map  = mmap(NULL, rs->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (rs->map == MAP_FAILED) { perror("mmap"); rs->map = NULL; return 0; }
+
+    const char *b = rs->map;
+    rs->hd = rs->map;
+    if (rs->hd->magic != RES_MAGIC ||
+        (size_t)rs->hd->colOff[RC_INSWIN] + rs->hd->nWin*sizeof(int) > rs->size){
+        fprintf(stderr, "%s: not a results file\n", path);
+        munmap(rs->map, rs->size); rs->map = NULL;
+        return 0;
+    }
+    rs->id          = b + rs->hd->colOff[RC_ID];
+    rs->period      = (const void *)(b + rs->hd->colOff[RC_PERIOD]);
+    rs->first       = (const void *)(b + rs->hd->colOff[RC_FIRST]);
+    rs->cand        = (const void *)(b + rs->hd->colOff[RC_CAND]);
+    rs->inst        = (const void *)(b + rs->hd->colOff[RC_INST]);
+    rs->attackable  = (const void *)(b + rs->hd->colOff[RC_ATTACKABLE]);
+    rs->atkWinLen   = (const void *)(b + rs->hd->colOff[RC_ATKWINLEN]);
+    rs->atkWinCount = (const void *)(b + rs->hd->colOff[RC_ATKWINCOUNT]);
+    rs->winOff      = (const void *)(b + rs->hd->colOff[RC_WINOFF]);
+    rs->atkWin      = (const void *)(b + rs->hd->colOff[RC_ATKWIN]);
+    rs->insWin      = (const void *)(b + rs->hd->colOff[RC_INSWIN]);
+    return 1;
+}
+
+void ResultsClose(struct Results *rs)
+{
+    if (rs->map) munmap(rs->map, rs->size);
+    rs->map = NULL;
+}
+
+/* final_candidates.csv from a results file (--csv / --export);
+   InstanceIndex is the row's rank within its candidate            */
+int ExportResultsCSV(const char *awr, const char *csv)
+{
+    struct Results rs;
+    if (!ResultsOpen(awr, &rs)) return 0;
+    FILE *f = fopen(csv, "w");
+    if (!f) { perror(csv); ResultsClose(&rs); return 0; }
+    setvbuf(f, NULL, _IOFBF, SINK_BUFSZ);
     fprintf(f,"CandidateID,Periodicity,InstanceIndex,Attackable,AtkWinLen,AtkWinCount\n");
-    for(int i=0;i<n;i++)
-        for(int j=0;j<c[i].count;j++)
-            fprintf(f,"%s,%.3f,%d,%d,%d,%d\n",
-                    c[i].ID,c[i].periodicity,
-                    j,c[i].instances[j].attackable,
-                    c[i].instances[j].atkWinLen,
-                    c[i].instances[j].atkWinCount);
+    for (int i = 0; i < rs.hd->nCand; i++){
+        const char *id = rs.id + (size_t)i*IDLEN;
+        for (long long r = rs.first[i]; r < rs.first[i+1]; r++)
+            fprintf(f,"%.*s,%.3f,%d,%d,%d,%d\n", IDLEN, id, rs.period[i],
+                    (int)(r - rs.first[i]), rs.attackable[r], rs.atkWinLen[r], rs.atkWinCount[r]);
+    }
     fclose(f);
+    ResultsClose(&rs);
+    return 1;
 }
+
 void SaveIDSummaryCSV(struct Message *c,int n){
     FILE *f=fopen("id_summary.csv","w");
     fprintf(f,"Identifier,Periodicity,MeanAtkWinLen,Attackable\n");
@@ -720,9 +1457,731 @@ void SaveIDSummaryCSV(struct Message *c,int n){
     fclose(f);
 }
 
+/* ─────────────  per-ID analysis cache (-c dir)  ────────────── */
+/* The first analysis pass (all patterns still 1) of a candidate
+   depends only on the trace, its own ID/period and busSpeed/minDlc/h,
+   so its state is stored per ID and reused by any later run whose -i
+   list contains that ID.  The only cross-candidate input, the sender
+   instance numbers in insWin, is stored as same-ID frame ordinals and
+   rebased to the current candidate list after loading.             */
+#define CACHE_MAGIC   0x31435741u         /* "AWC1" */
+
+struct CacheHdr{
+    unsigned           magic;
+    unsigned long long traceHash;
+    float              busSpeed;
+    int                minDlc;
+    int                h;
+    float              periodicity;
+    int                count;
+};
+
+/* FNV-1a over the raw log files, in order, and their clock offsets
+   into *out; 0 if a file cannot be read again (stdin cannot), since
+   any other key would match a different trace.                      */
+int TraceFingerprint(const struct LogSource *src, int k, unsigned long long *out)
+{
+    unsigned long long hash = 1469598103934665603ULL;
+    unsigned char buf[1 << 16];
+    size_t n;
+    for (int f = 0; f < k; f++){
+        if (strcmp(src[f].path, "-") == 0){
+            fprintf(stderr, "stdin cannot be fingerprinted\n");
+            return 0;
+        }
+        FILE *fp = fopen(src[f].path, "rb");
+        if (!fp) { perror(src[f].path); return 0; }
+        while ((n = fread(buf, 1, sizeof buf, fp)) > 0)
+            for (size_t i = 0; i < n; i++){
+                hash ^= buf[i];
+                hash *= 1099511628211ULL;
+            }
+        fclose(fp);
+        if (src[f].offset != 0)              /* single-file keys unchanged */
+            for (size_t i = 0; i < sizeof src[f].offset; i++){
+                hash ^= ((const unsigned char *)&src[f].offset)[i];
+                hash *= 1099511628211ULL;
+            }
+    }
+    *out = hash;
+    return 1;
+}
+
+static void CacheHeader(struct CacheHdr *hd, unsigned long long traceHash,
+                        const struct Message *m)
+{
+    memset(hd, 0, sizeof *hd);
+    hd->magic       = CACHE_MAGIC;
+    hd->traceHash   = traceHash;
+    hd->busSpeed    = busSpeed;
+    hd->minDlc      = minDlc;
+    hd->h           = h;
+    hd->periodicity = m->periodicity;
+    hd->count       = m->count;
+}
+
+/* <dir>/<ID>_<hash of trace+params>.awc */
+static void CachePath(char *path, size_t n, const char *dir, const struct CacheHdr *hd,
+                      const char *id)
+{
+    unsigned long long key = hd->traceHash;
+    const unsigned char *p = (const unsigned char *)&hd->busSpeed;
+    for (size_t i = 0; i < sizeof *hd - offsetof(struct CacheHdr, busSpeed); i++){
+        key ^= p[i];
+        key *= 1099511628211ULL;
+    }
+    snprintf(path, n, "%s/%s_%016llx.awc", dir, id, key);
+}
+
+static int ReadInts(FILE *fp, int **dst, int n)
+{
+    *dst = calloc(n, sizeof(int));
+    if (n && !*dst) { perror("calloc"); exit(EXIT_FAILURE); }
+    return (int)fread(*dst, sizeof(int), n, fp) == n;
+}
+
+/* Analysis state of one candidate (readCount, open window, instance
+   windows), shared by the cache and the checkpoint log.             */
+void WriteCandidateState(FILE *fp, const struct Message *m)
+{
+    fwrite(&m->readCount,    sizeof(int), 1, fp);
+    fwrite(&m->tAtkWinLen,   sizeof(int), 1, fp);
+    fwrite(&m->tAtkWinCount, sizeof(int), 1, fp);
+    if (m->tAtkWinLen > 0){
+        fwrite(m->tAtkWin, sizeof(int), m->tAtkWinCount, fp);
+        fwrite(m->tInsWin, sizeof(int), m->tAtkWinCount, fp);
+    }
+}
+
+void WriteInstanceState(FILE *fp, const struct Instance *in)
+{
+    fwrite(&in->index,       sizeof(int), 1, fp);
+    fwrite(&in->atkWinLen,   sizeof(int), 1, fp);
+    fwrite(&in->atkWinCount, sizeof(int), 1, fp);
+    if (in->atkWinCount > 0){
+        fwrite(in->atkWin, sizeof(int), in->atkWinCount, fp);
+        fwrite(in->insWin, sizeof(int), in->atkWinCount, fp);
+    }
+}
+
+/* both readers replace (and free) whatever the target held */
+int ReadCandidateState(FILE *fp, struct Message *m)
+{
+    if (m->tAtkWinLen > 0){ free(m->tAtkWin); free(m->tInsWin); }
+    m->tAtkWin = m->tInsWin = NULL;
+    int ok = fread(&m->readCount,    sizeof(int), 1, fp) == 1
+          && fread(&m->tAtkWinLen,   sizeof(int), 1, fp) == 1
+          && fread(&m->tAtkWinCount, sizeof(int), 1, fp) == 1;
+    if (ok && m->tAtkWinLen > 0)
+        ok = ReadInts(fp, &m->tAtkWin, m->tAtkWinCount)
+          && ReadInts(fp, &m->tInsWin, m->tAtkWinCount);
+    if (!ok){
+        free(m->tAtkWin); free(m->tInsWin);
+        m->tAtkWin = m->tInsWin = NULL;
+        m->readCount = m->tAtkWinLen = m->tAtkWinCount = 0;
+    }
+    return ok;
+}
+
+int ReadInstanceState(FILE *fp, struct Instance *in)
+{
+    free(in->atkWin); free(in->insWin);
+    in->atkWin = in->insWin = NULL;
+    int ok = fread(&in->index,       sizeof(int), 1, fp) == 1
+          && fread(&in->atkWinLen,   sizeof(int), 1, fp) == 1
+          && fread(&in->atkWinCount, sizeof(int), 1, fp) == 1;
+    if (ok && in->atkWinCount > 0)
+        ok = ReadInts(fp, &in->atkWin, in->atkWinCount)
+          && ReadInts(fp, &in->insWin, in->atkWinCount);
+    if (!ok){
+        free(in->atkWin); free(in->insWin);
+        in->atkWin = in->insWin = NULL;
+        in->atkWinLen = in->atkWinCount = 0;
+    }
+    return ok;
+}
+
+int SaveCachedCandidate(const char *dir, unsigned long long traceHash, const struct Message *m)
+{
+    struct CacheHdr hd;
+    char path[512];
+    CacheHeader(&hd, traceHash, m);
+    CachePath(path, sizeof path, dir, &hd, m->ID);
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) { perror(path); return -1; }
+    fwrite(&hd, sizeof hd, 1, fp);
+    WriteCandidateState(fp, m);
+    for (int j = 0; j < m->count; j++)
+        WriteInstanceState(fp, &m->instances[j]);
+    if (fclose(fp) != 0) { perror(path); return -1; }
+    return 0;
+}
+
+/* 1 = loaded, 0 = miss (no file / stale / truncated) */
+int LoadCachedCandidate(const char *dir, unsigned long long traceHash, struct Message *m)
+{
+    struct CacheHdr hd, want;
+    char path[512];
+    CacheHeader(&want, traceHash, m);
+    CachePath(path, sizeof path, dir, &want, m->ID);
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    int ok = fread(&hd, sizeof hd, 1, fp) == 1 && memcmp(&hd, &want, sizeof hd) == 0
+          && ReadCandidateState(fp, m);
+    for (int j = 0; ok && j < m->count; j++)
+        ok = ReadInstanceState(fp, &m->instances[j]);
+    fclose(fp);
+    if (!ok){
+        REPORT(REP_ROUND, "\n cache: ignoring stale %s", path);
+        for (int j = 0; j < m->count; j++){
+            free(m->instances[j].atkWin); free(m->instances[j].insWin);
+            m->instances[j].atkWin = m->instances[j].insWin = NULL;
+            m->instances[j].atkWinLen = m->instances[j].atkWinCount = 0;
+            m->instances[j].index = j;
+        }
+        if (m->tAtkWinLen > 0){ free(m->tAtkWin); free(m->tInsWin); }
+        m->tAtkWin = m->tInsWin = NULL;
+        m->readCount = m->tAtkWinLen = m->tAtkWinCount = 0;
+    }
+    return ok;
+}
+
+/* frameOrd[j] = number of earlier frames carrying the ID of frame j */
+int *ComputeFrameOrdinals(struct Message *traffic, int CANCount)
+{
+    int *ids = malloc(CANCount * sizeof *ids);
+    int *idx = malloc(CANCount * sizeof *idx);
+    int *ord = malloc(CANCount * sizeof *ord);
+    if (!ids || !idx || !ord) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (int j = 0; j < CANCount; j++){
+        ids[j] = (int)id_to_long(traffic[j].ID);
+        idx[j] = j;
+    }
+    IntSort(ids, idx, 0, CANCount - 1);        /* stable: by ID, then j */
+    for (int j = 0; j < CANCount; j++)
+        ord[idx[j]] = (j > 0 && ids[j] == ids[j-1]) ? ord[idx[j-1]] + 1 : 0;
+    free(ids); free(idx);
+    return ord;
+}
+
+/* ordinal → what GetCurrentInstance() would have returned in a plain
+   first pass: the sender's readCount, already bumped for this frame
+   when the sender sits earlier in the candidate list, or -1 when the
+   sender is not a candidate at all.  Senders are matched by value.   */
+static void RebaseInsWin(struct Message *c, int n, int self, int *atkWin, int *insWin, int cnt)
+{
+    for (int k = 0; k < cnt; k++){
+        int ins = -1;
+        for (int i = 0; i < n; i++)
+            if (id_to_long(c[i].ID) == atkWin[k]){ ins = insWin[k] + (i < self); break; }
+        insWin[k] = ins;
+    }
+}
+
+/* First pass of the round loop: load every candidate found in the
+   cache, analyse only the rest, store them, then rebase insWin.      */
+void AnalyzeFirstPassCached(struct Message *traffic, int CANCount, struct Message *cand,
+                            int nCand, unsigned long long traceHash, const char *dir)
+{
+    struct Message *miss = calloc(nCand, sizeof *miss);
+    int *missAt = calloc(nCand, sizeof *missAt);
+    int  nMiss = 0;
+    if (!miss || !missAt) { perror("calloc"); exit(EXIT_FAILURE); }
+
+    for (int i = 0; i < nCand; i++)
+        if (!LoadCachedCandidate(dir, traceHash, &cand[i])){
+            missAt[nMiss] = i;
+            miss[nMiss++] = cand[i];
+        }
+    REPORT(REP_SUMMARY, "Cache: %d of %d candidates loaded, analysing %d\n",
+           nCand - nMiss, nCand, nMiss);
+
+    if (nMiss > 0){
+        FILE *ckptFp = ckpt.fp;                /* no deltas of a subset */
+        ckpt.fp  = NULL;
+        frameOrd = ComputeFrameOrdinals(traffic, CANCount);
+        AnalyzeCANTraffic(traffic, CANCount, &miss, nMiss);
+        free(frameOrd);
+        frameOrd = NULL;
+        ckpt.fp  = ckptFp;
+        for (int m = 0; m < nMiss; m++){
+            cand[missAt[m]] = miss[m];
+            SaveCachedCandidate(dir, traceHash, &miss[m]);
+        }
+    }
+
+    for (int i = 0; i < nCand; i++){
+        for (int j = 0; j < cand[i].count; j++)
+            RebaseInsWin(cand, nCand, i, cand[i].instances[j].atkWin,
+                         cand[i].instances[j].insWin, cand[i].instances[j].atkWinCount);
+        if (cand[i].tAtkWinLen > 0)
+            RebaseInsWin(cand, nCand, i, cand[i].tAtkWin, cand[i].tInsWin,
+                         cand[i].tAtkWinCount);
+    }
+    free(miss); free(missAt);
+}
+
+/* ─────────────  checkpoint / resume (-k, --resume)  ───────── */
+/* The log holds one base snapshot of the complete analysis state
+   (candidate order, patterns, instances, windows, readCount, trace
+   offset), rewritten at the start of every round, followed by delta
+   records appended every ckpt.every hyper-periods of trace.  A delta
+   carries the per-candidate scalars and open windows plus only the
+   instances touched since the previous record; each is length-framed
+   so a torn tail is simply ignored on resume.                      */
+#define CKPT_BASE_MAGIC  0x32424b43u      /* "CKB2" */
+#define CKPT_DELTA_MAGIC 0x31444b43u      /* "CKD1" */
+
+struct CkptHdr{
+    unsigned           magic;
+    unsigned long long traceHash;
+    float              busSpeed;
+    int                minDlc;
+    int                h;
+    int                nCand;
+    int                round;
+    int                frame;
+};
+
+static void CkptHeader(struct CkptHdr *hd, int n, int round, int frame)
+{
+    memset(hd, 0, sizeof *hd);
+    hd->magic     = CKPT_BASE_MAGIC;
+    hd->traceHash = ckpt.traceHash;
+    hd->busSpeed  = busSpeed;
+    hd->minDlc    = minDlc;
+    hd->h         = h;
+    hd->nCand     = n;
+    hd->round     = round;
+    hd->frame     = frame;
+}
+
+/* full snapshot → <path>.tmp, renamed over <path>, reopened for deltas.
+   prevAtk/prevLen are main's last reported stats, so a resumed -j
+   stream only carries changes.  On failure no checkpoint is left:
+   the old log's deltas belong to an earlier round.                 */
+int CheckpointBase(struct Message *c, int n, int round, int frame,
+                   const int *prevAtk, const int *prevLen)
+{
+    struct CkptHdr hd;
+    char tmp[512];
+    snprintf(tmp, sizeof tmp, "%s.tmp", ckpt.path);
+    if (ckpt.fp) { fclose(ckpt.fp); ckpt.fp = NULL; }
+
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) { perror(tmp); remove(ckpt.path); return -1; }
+    CkptHeader(&hd, n, round, frame);
+    fwrite(&hd, sizeof hd, 1, fp);
+    for (int i = 0; i < n; i++){
+        fwrite(c[i].ID,           1,           IDLEN, fp);
+        fwrite(&c[i].count,       sizeof(int), 1, fp);
+        fwrite(&c[i].atkWinLen,   sizeof(int), 1, fp);
+        fwrite(&prevAtk[i],       sizeof(int), 1, fp);
+        fwrite(&prevLen[i],       sizeof(int), 1, fp);
+        fwrite(c[i].pattern,      sizeof(int), c[i].count, fp);
+        WriteCandidateState(fp, &c[i]);
+        for (int j = 0; j < c[i].count; j++){
+            fwrite(&c[i].instances[j].attackable, sizeof(int), 1, fp);
+            WriteInstanceState(fp, &c[i].instances[j]);
+            c[i].instances[j].dirty = 0;
+        }
+    }
+    if (fclose(fp) != 0 || rename(tmp, ckpt.path) != 0){
+        perror(ckpt.path);
+        remove(tmp); remove(ckpt.path);
+        return -1;
+    }
+    ckpt.fp = fopen(ckpt.path, "ab");
+    if (!ckpt.fp) { perror(ckpt.path); remove(ckpt.path); return -1; }
+    return 0;
+}
+
+void CheckpointDelta(struct Message *c, int n, int frame)
+{
+    char  *buf = NULL;
+    size_t len = 0;
+    FILE *ms = open_memstream(&buf, &len);
+    if (!ms) { perror("open_memstream"); return; }
+
+    fwrite(&frame, sizeof(int), 1, ms);
+    for (int i = 0; i < n; i++){
+        int nDirty = 0;
+        WriteCandidateState(ms, &c[i]);
+        for (int j = 0; j < c[i].count; j++) nDirty += c[i].instances[j].dirty;
+        fwrite(&nDirty, sizeof(int), 1, ms);
+        for (int j = 0; j < c[i].count; j++)
+            if (c[i].instances[j].dirty){
+                fwrite(&j, sizeof(int), 1, ms);
+                WriteInstanceState(ms, &c[i].instances[j]);
+                c[i].instances[j].dirty = 0;
+            }
+    }
+    fclose(ms);
+
+    unsigned magic = CKPT_DELTA_MAGIC, sz = (unsigned)len;
+    fwrite(&magic, sizeof magic, 1, ckpt.fp);
+    fwrite(&sz,    sizeof sz,    1, ckpt.fp);
+    fwrite(buf, 1, len, ckpt.fp);
+    fflush(ckpt.fp);
+    free(buf);
+    REPORT(REP_ROUND, "\n checkpoint: frame %d (+%u bytes)", frame, sz);
+}
+
+static int ApplyDelta(FILE *fp, struct Message *c, int n, int *frame)
+{
+    int ok = fread(frame, sizeof(int), 1, fp) == 1;
+    for (int i = 0; ok && i < n; i++){
+        int nDirty = 0, slot = 0;
+        ok = ReadCandidateState(fp, &c[i])
+          && fread(&nDirty, sizeof(int), 1, fp) == 1;
+        for (int d = 0; ok && d < nDirty; d++)
+            ok = fread(&slot, sizeof(int), 1, fp) == 1
+              && slot >= 0 && slot < c[i].count
+              && ReadInstanceState(fp, &c[i].instances[slot]);
+    }
+    return ok;
+}
+
+/* Restore the state of a run interrupted in round *round.  c must be
+   freshly initialised with the same candidate set; returns 1 on success. */
+int ResumeCheckpoint(struct Message *c, int n, int *round, int *prevAtk, int *prevLen)
+{
+    struct CkptHdr hd, want;
+    FILE *fp = fopen(ckpt.path, "rb");
+    if (!fp) { perror(ckpt.path); return 0; }
+
+    int ok = fread(&hd, sizeof hd, 1, fp) == 1;
+    CkptHeader(&want, n, ok ? hd.round : 0, ok ? hd.frame : 0);
+    ok = ok && memcmp(&hd, &want, sizeof hd) == 0;
+    for (int i = 0; ok && i < n; i++){
+        char id[IDLEN];
+        int  count = 0, k;
+        ok = fread(id, 1, IDLEN, fp) == IDLEN && fread(&count, sizeof(int), 1, fp) == 1;
+        for (k = i; ok && k < n && strncmp(c[k].ID, id, IDLEN) != 0; k++) ;
+        if (!ok || k == n || c[k].count != count) { ok = 0; break; }
+        struct Message t = c[k]; c[k] = c[i]; c[i] = t;   /* policy-3 order */
+        ok = fread(&c[i].atkWinLen, sizeof(int), 1, fp) == 1
+          && fread(&prevAtk[i], sizeof(int), 1, fp) == 1
+          && fread(&prevLen[i], sizeof(int), 1, fp) == 1
+          && (int)fread(c[i].pattern, sizeof(int), count, fp) == count
+          && ReadCandidateState(fp, &c[i]);
+        for (int j = 0; ok && j < count; j++)
+            ok = fread(&c[i].instances[j].attackable, sizeof(int), 1, fp) == 1
+              && ReadInstanceState(fp, &c[i].instances[j]);
+    }
+    if (!ok){
+        fprintf(stderr, "%s: checkpoint does not match this trace/candidate set\n", ckpt.path);
+        fclose(fp);
+        return 0;
+    }
+
+    int frame = hd.frame, deltas = 0;
+    unsigned magic, sz;
+    while (fread(&magic, sizeof magic, 1, fp) == 1 && magic == CKPT_DELTA_MAGIC
+           && fread(&sz, sizeof sz, 1, fp) == 1){
+        char *buf = malloc(sz);
+        if (!buf) { perror("malloc"); exit(EXIT_FAILURE); }
+        if (fread(buf, 1, sz, fp) != sz) { free(buf); break; }   /* torn tail */
+        FILE *ms = fmemopen(buf, sz, "rb");
+        int f = 0;
+        if (ms && ApplyDelta(ms, c, n, &f)) { frame = f; deltas++; }
+        if (ms) fclose(ms);
+        free(buf);
+    }
+    fclose(fp);
+
+    *round = hd.round;
+    ckpt.resumeFrame = frame;
+    REPORT(REP_SUMMARY, "Resumed round %d at frame %d (%d deltas)\n", hd.round, frame, deltas);
+    return 1;
+}
+
+/* ─────────────  replay of skip patterns (--replay)  ────────── */
+/* Applies the patterns to the loaded trace without copying it: a
+   one-byte drop mask per frame, with the new start times worked out
+   on the fly while the analysis walks the survivors.  A frame that
+   followed an idle bus keeps its time; a frame that was queued behind
+   its predecessor (gap < maxIdle) now starts that same gap after the
+   last transmitted frame ends, but not before its busy period began.
+   The rewritten trace is then analysed in one fresh pass; scoring
+   only needs each instance's window length, so ReplayScore() keeps
+   that and skips the window lists (ReplayAnalyze() builds them).    */
+
+/* next surviving frame after j and its shifted start, given that
+   the frame at j now ends at endAt; *busy tracks the busy period   */
+int ReplayNext(struct Message *T, int CANCount, int j, float endAt, float *busy, float *start)
+{
+    float maxIdle = (minDlc*8+47)/(busSpeed*1000);
+    int n;
+    for (n = j + 1; n < CANCount; n++){
+        float origPrevEnd = T[n-1].txTime + (T[n-1].DLC*8 + 47)/(busSpeed*1000);
+        if (T[n].txTime - origPrevEnd > maxIdle) *busy = T[n].txTime;
+        if (replay->drop[n]) continue;
+        if (T[n].txTime - origPrevEnd > maxIdle) *start = T[n].txTime;
+        else *start = fmaxf(endAt + (T[n].txTime - origPrevEnd), *busy);
+        break;
+    }
+    return n;
+}
+
+void ReplayInit(struct Replay *rp, struct Message *traffic, int CANCount,
+                struct Message *c, int n)
+{
+    struct PolicyEngine pe;
+    PolicyEngineInit(&pe, n);
+    PolicyEngineBuild(&pe, c);
+    rp->ord   = ComputeFrameOrdinals(traffic, CANCount);
+    rp->owner = malloc(CANCount * sizeof(int));
+    rp->drop  = calloc(CANCount, 1);
+    if (!rp->owner || !rp->drop) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (int j = 0; j < CANCount; j++){
+        int q = FirstOf(&pe, id_to_long(traffic[j].ID));
+        rp->owner[j] = q < 0 ? -1 : pe.idx[q].pos;
+    }
+    PolicyEngineFree(&pe);
+}
+
+void ReplayFree(struct Replay *rp)
+{
+    free(rp->ord); free(rp->owner); free(rp->drop);
+}
+
+/* drop mask for patterns[i] (NULL = send everything) */
+static void ReplayMask(struct Replay *rp, int CANCount, struct Message *c, int **patterns)
+{
+    for (int j = 0; j < CANCount; j++){
+        int o = rp->owner[j];
+        rp->drop[j] = patterns && o >= 0 && patterns[o]
+                    && !patterns[o][rp->ord[j] % c[o].count];
+    }
+}
+
+/* Re-analyses the trace with every candidate of c[] following
+   patterns[i] (NULL = send everything): masks the skipped frames and
+   runs the shifted trace through fresh scratch candidates, returned
+   for ReplayRelease().                                              */
+struct Message *ReplayAnalyze(struct Replay *rp, struct Message *traffic, int CANCount,
+                              struct Message *c, int n, int **patterns)
+{
+    struct Message *sc = calloc(n, sizeof *sc);
+    if (!sc) { perror("calloc"); exit(EXIT_FAILURE); }
+    ReplayMask(rp, CANCount, c, patterns);
+    for (int i = 0; i < n; i++){
+        memcpy(sc[i].ID, c[i].ID, IDLEN);
+        sc[i].periodicity = c[i].periodicity;
+        sc[i].count       = c[i].count;
+        sc[i].skipLimit   = c[i].skipLimit;
+        sc[i].pattern     = c[i].pattern;          /* not read while replaying */
+        sc[i].instances   = calloc(c[i].count, sizeof(struct Instance));
+        if (!sc[i].instances) { perror("calloc"); exit(EXIT_FAILURE); }
+        for (int j = 0; j < c[i].count; j++) sc[i].instances[j].index = j;
+    }
+
+    FILE *ckptFp = ckpt.fp;                    /* scratch state: no deltas */
+    ckpt.fp = NULL;
+    replay  = rp;
+    AnalyzeCANTraffic(traffic, CANCount, &sc, n);
+    replay  = NULL;
+    ckpt.fp = ckptFp;
+    return sc;
+}
+
+/* ReplayAnalyze() cut down to the per-instance atkWinLen, written to
+   len[i][slot]: the same walk over the shifted trace, but per
+   candidate only the running window length and its read count, so
+   no window lists are allocated, sorted or intersected.            */
+void ReplayWinLen(struct Replay *rp, struct Message *traffic, int CANCount,
+                  struct Message *c, int n, int **patterns, int **len)
+{
+    float maxIdle = (minDlc*8+47)/(busSpeed*1000);
+    long *idEcu = malloc((n ? n : 1) * sizeof *idEcu);
+    int  *tLen  = calloc(n ? n : 1, sizeof *tLen);
+    int  *read  = calloc(n ? n : 1, sizeof *read);
+    if (!idEcu || !tLen || !read) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < n; i++){
+        idEcu[i] = id_to_long(c[i].ID);
+        memset(len[i], 0, c[i].count * sizeof(int));
+    }
+    ReplayMask(rp, CANCount, c, patterns);
+
+    int j = 0;
+    float start = 0, busy = 0;
+    while (j < CANCount && rp->drop[j]) j++;
+    if (j < CANCount) start = busy = traffic[j].txTime;
+    replay = rp;
+    while (j < CANCount - 1){
+        long  idPkt   = id_to_long(traffic[j].ID);
+        int   bits    = traffic[j].DLC*8 + 47;
+        float txStart = start, txEnds = bits/(busSpeed*1000), nextStart;
+        int   next    = ReplayNext(traffic, CANCount, j, start + txEnds, &busy, &nextStart);
+        if (next >= CANCount) break;
+        start = nextStart;
+        int idle = (nextStart - (txStart + txEnds)) > maxIdle;
+        for (int i = 0; i < n; i++){
+            if (idPkt > idEcu[i] || (idle && idPkt != idEcu[i]))
+                tLen[i] = 0;                               /* window closed */
+            else if (idPkt < idEcu[i])
+                tLen[i] += bits;
+            else{                                          /* own frame */
+                int x = rp->ord[j] % c[i].count;
+                if (read[i] < c[i].count || tLen[i] < len[i][x]) len[i][x] = tLen[i];
+                tLen[i] = 0;
+                read[i] = rp->ord[j] + 1;
+            }
+        }
+        j = next;
+    }
+    replay = NULL;
+    free(idEcu); free(tLen); free(read);
+}
+
+void ReplayRelease(struct Message *sc, int n)
+{
+    for (int i = 0; i < n; i++){
+        for (int j = 0; j < sc[i].count; j++){
+            free(sc[i].instances[j].atkWin);
+            free(sc[i].instances[j].insWin);
+        }
+        if (sc[i].tAtkWinLen > 0){ free(sc[i].tAtkWin); free(sc[i].tInsWin); }
+        free(sc[i].instances);
+    }
+    free(sc);
+}
+
+/* attackable instances left when c[] follows patterns[]: those
+   still sent with atkWinLen >= minAtkWinLen                        */
+long ReplayScore(struct Replay *rp, struct Message *traffic, int CANCount,
+                 struct Message *c, int n, int **patterns)
+{
+    int **len = malloc((n ? n : 1) * sizeof *len);
+    if (!len) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < n; i++){
+        len[i] = malloc((c[i].count ? c[i].count : 1) * sizeof(int));
+        if (!len[i]) { perror("malloc"); exit(EXIT_FAILURE); }
+    }
+    ReplayWinLen(rp, traffic, CANCount, c, n, patterns, len);
+
+    long left = 0;
+    for (int i = 0; i < n; i++){
+        for (int j = 0; j < c[i].count; j++){
+            int sent = !patterns || !patterns[i] || patterns[i][j];
+            left += sent && len[i][j] >= minAtkWinLen;
+        }
+        free(len[i]);
+    }
+    free(len);
+    return left;
+}
+
+/* --replay: score the final patterns against the unmodified trace */
+void ReportReplay(struct Message *traffic, int CANCount, struct Message *c, int n, int round)
+{
+    struct Replay rp;
+    int **pats = malloc(n * sizeof *pats);
+    if (!pats) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < n; i++) pats[i] = c[i].pattern;
+
+    double t0 = NowSec();
+    ReplayInit(&rp, traffic, CANCount, c, n);
+    double t1 = NowSec();
+    long before = ReplayScore(&rp, traffic, CANCount, c, n, NULL);
+    double t2 = NowSec();
+    long after  = ReplayScore(&rp, traffic, CANCount, c, n, pats);
+    double t3 = NowSec();
+    long dropped = 0;
+    for (int j = 0; j < CANCount; j++) dropped += rp.drop[j];
+
+    REPORT(REP_SUMMARY, "\nReplay: %ld of %d frames skipped\n", dropped, CANCount);
+    REPORT(REP_SUMMARY, "  attackable instances before = %ld, after = %ld\n", before, after);
+    REPORT(REP_SUMMARY, "  index %.3f ms, evaluation %.3f ms (%.0f patterns/s)\n",
+           (t1 - t0) * 1e3, (t3 - t2) * 1e3, 1.0 / (t3 - t2 > 0 ? t3 - t2 : 1e-9));
+    JSONL("{\"round\":%d,\"event\":\"replay\",\"dropped\":%ld,"
+          "\"before\":%ld,\"after\":%ld}\n", round, dropped, before, after);
+    ReplayFree(&rp);
+    free(pats);
+}
+
+/* take m's instance state from its replayed scratch copy r */
+static void AdoptReplayState(struct Message *m, struct Message *r)
+{
+    long sum = 0;
+    for (int j = 0; j < m->count; j++){
+        struct Instance *in = &m->instances[j], *rs = &r->instances[in->index];
+        free(in->atkWin); free(in->insWin);
+        in->atkWinLen   = rs->atkWinLen;
+        in->atkWinCount = rs->atkWinCount;
+        in->atkWin      = rs->atkWin;
+        in->insWin      = rs->insWin;
+        in->attackable  = in->atkWinLen >= minAtkWinLen;
+        in->dirty       = 1;
+        rs->atkWin = rs->insWin = NULL;
+        sum += in->atkWinLen;
+    }
+    m->atkWinLen = sum / m->count;
+    InsSortByAtkWinLen(&m->instances, 0, m->count - 1);
+}
+
+/* -p optimal: solve every candidate on the round-0 attackability,
+   replay the greedy and the solver patterns against the unmodified
+   trace, and adopt the solver's (with the instance state they
+   replay to) only when they leave fewer attackable instances.      */
+void ApplySolver(struct Message *traffic, int CANCount, struct Message *c, int n,
+                 int round, double greedySec)
+{
+    struct Replay rp;
+    long gSkips = 0, sSkips = 0;
+    int **gPat = malloc(n * sizeof *gPat);
+    int **sPat = malloc(n * sizeof *sPat);
+    if (!gPat || !sPat) { perror("malloc"); exit(EXIT_FAILURE); }
+    ReplayInit(&rp, traffic, CANCount, c, n);
+
+    struct Message *base = ReplayAnalyze(&rp, traffic, CANCount, c, n, NULL);
+    double t0 = NowSec();
+    for (int i = 0; i < n; i++){
+        for (int j = 0; j < base[i].count; j++)
+            base[i].instances[j].attackable = base[i].instances[j].atkWinLen >= minAtkWinLen;
+        sPat[i] = malloc((c[i].count ? c[i].count : 1) * sizeof(int));
+        if (!sPat[i]) { perror("malloc"); exit(EXIT_FAILURE); }
+        sSkips += SolveSkipPattern(&base[i], sPat[i]);
+        gPat[i] = c[i].pattern;
+        for (int j = 0; j < c[i].count; j++) gSkips += !c[i].pattern[j];
+    }
+    double solverSec = NowSec() - t0;
+    ReplayRelease(base, n);
+
+    long gLeft = ReplayScore(&rp, traffic, CANCount, c, n, gPat);
+    long sLeft = ReplayScore(&rp, traffic, CANCount, c, n, sPat);
+    int adopt = sLeft < gLeft;
+    if (adopt){                        /* full windows only for the winner */
+        struct Message *sc = ReplayAnalyze(&rp, traffic, CANCount, c, n, sPat);
+        for (int i = 0; i < n; i++){
+            memcpy(c[i].pattern, sPat[i], c[i].count * sizeof(int));
+            ZeroRunBuild(&c[i]);
+            AdoptReplayState(&c[i], &sc[i]);
+        }
+        ReplayRelease(sc, n);
+    }
+    ReplayFree(&rp);
+    for (int i = 0; i < n; i++) free(sPat[i]);
+    free(gPat); free(sPat);
+
+    REPORT(REP_SUMMARY, "\nPolicy     Time(ms)  AttackableLeft  Skips\n");
+    REPORT(REP_SUMMARY, "greedy   %10.3f  %14ld  %5ld\n", greedySec * 1e3, gLeft, gSkips);
+    REPORT(REP_SUMMARY, "optimal  %10.3f  %14ld  %5ld\n", solverSec * 1e3, sLeft, sSkips);
+    REPORT(REP_SUMMARY, "gap: greedy leaves %ld more attackable instance(s) on replay; "
+                        "keeping the %s patterns\n", gLeft - sLeft, adopt ? "optimal" : "greedy");
+    JSONL("{\"round\":%d,\"event\":\"solver\",\"greedyLeft\":%ld,"
+          "\"optimalLeft\":%ld,\"adopted\":\"%s\"}\n",
+          round, gLeft, sLeft, adopt ? "optimal" : "greedy");
+}
+
+
 /* ─────────────  dynamic list (-i)  ─────────────────────────── */
 #define MAX_ECU 64
 char  dynIDs[MAX_ECU][IDLEN];
+const char *dynIDPtrs[MAX_ECU];
 float dynPeriods[MAX_ECU];
 int   dynSkip[MAX_ECU];
 int   dynCount=0, useDynamic=0;
@@ -756,23 +2215,623 @@ void fill_periods(void){
     fclose(fp);
 }
 
+/* ─────────────  end-of-run summary (REP_SUMMARY)  ─────────── */
+void ReportSummary(struct Message *c,int n,int rounds){
+    long totAtk=0,totIns=0;
+    REPORT(REP_SUMMARY,"\nSummary after %d rounds\n",rounds);
+    REPORT(REP_SUMMARY,"%-8s %8s %10s %10s %6s\n",
+           "ID","Period","Attackable","MeanAtkWin","Skips");
+    for(int i=0;i<n;i++){
+        int atk=0,skips=0;
+        for(int j=0;j<c[i].count;j++){
+            atk  +=c[i].instances[j].attackable;
+            skips+=!c[i].pattern[j];
+        }
+        totAtk+=atk; totIns+=c[i].count;
+        REPORT(REP_SUMMARY,"%-8s %8.4f %5d/%-4d %10d %6d\n",
+               c[i].ID,c[i].periodicity,atk,c[i].count,c[i].atkWinLen,skips);
+    }
+    REPORT(REP_SUMMARY,"Total attackable instances: %ld/%ld\n",totAtk,totIns);
+}
+
 /* ─────────────  main  ──────────────────────────────────────── */
-int main(int argc,char **argv)
+/* ─────────────  per-hyper-period features (-f file)  ──────── */
+/* The make_dataset.py table, computed natively, plus payload
+   features when the D0..D7 column was kept:
+     byteEntropy  Shannon entropy (bits) of the payload bytes
+                  (first DLC bytes of each frame)
+     bitFlipRate  changed bits / 64 per frame against the previous
+                  frame of the same ID (may lie in the last period)
+     constMask    bit i set when byte Di is sent by every frame of the
+                  period (i < DLC) and never changes
+   The payload kernels run over one packed uint64 word per frame.
+   flips and changed bits have AVX2 versions (xor/or on 4 words, a
+   nibble-table popcount) chosen at run time, with a popcnt and a
+   plain scalar fallback, so the -O2 build needs no -m flags.  The
+   byte histogram behind the entropy is a scatter that SSE/AVX2
+   cannot vectorise; it stays scalar, branch-free per byte.        */
+struct HyperRow{
+    char     ID[IDLEN];
+    int      hyperIdx;
+    int      nFrames;
+    double   meanGapMs;
+    double   stdGapMs;
+    long     utilBits;
+    double   byteEntropy;
+    double   bitFlipRate;
+    unsigned constMask;
+};
+
+#ifdef PAYLOAD_X86
+__attribute__((target("avx2,popcnt")))
+static long PayloadFlipsAvx2(const uint64_t *w, int m)
+{
+    const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                         0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low = _mm256_set1_epi8(0x0F), zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    int k = 1;
+    for (; k + 4 <= m; k += 4){
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(w + k)),
+                                     _mm256_loadu_si256((const __m256i *)(w + k - 1)));
+        __m256i c = _mm256_add_epi8(
+            _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low)),
+            _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(c, zero));   /* 4 x 64-bit sums */
+    }
+    uint64_t lane[4];
+    _mm256_storeu_si256((__m256i *)lane, acc);
+    long flips = lane[0] + lane[1] + lane[2] + lane[3];
+    for (; k < m; k++) flips += __builtin_popcountll(w[k] ^ w[k-1]);
+    return flips;
+}
+
+__attribute__((target("popcnt")))
+static long PayloadFlipsPopcnt(const uint64_t *w, int m)
 {
-    if(argc<2){ puts("usage: ./sched_attack <csv> [-i id1,id2]"); return 1; }
-    char *csvFile=argv[1];
+    long flips = 0;
+    for (int k = 1; k < m; k++)
+        flips += __builtin_popcountll(w[k] ^ w[k-1]);
+    return flips;
+}
+
+__attribute__((target("avx2")))
+static uint64_t PayloadChangedAvx2(const uint64_t *w, int m)
+{
+    const __m256i w0 = _mm256_set1_epi64x((long long)w[0]);
+    __m256i acc = _mm256_setzero_si256();
+    int k = 1;
+    for (; k + 4 <= m; k += 4)
+        acc = _mm256_or_si256(acc,
+              _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(w + k)), w0));
+    uint64_t lane[4];
+    _mm256_storeu_si256((__m256i *)lane, acc);
+    uint64_t changed = lane[0] | lane[1] | lane[2] | lane[3];
+    for (; k < m; k++) changed |= w[k] ^ w[0];
+    return changed;
+}
+#endif
 
-    int opt; while((opt=getopt(argc-1,argv+1,"i:"))!=-1)
+/* Σ popcount(w[k] ^ w[k-1]) over k = 1..m-1 */
+static long PayloadFlips(const uint64_t *w, int m)
+{
+#ifdef PAYLOAD_X86
+    if (__builtin_cpu_supports("avx2"))   return PayloadFlipsAvx2(w, m);
+    if (__builtin_cpu_supports("popcnt")) return PayloadFlipsPopcnt(w, m);
+#endif
+    long flips = 0;
+    for (int k = 1; k < m; k++)
+        flips += __builtin_popcountll(w[k] ^ w[k-1]);
+    return flips;
+}
+
+/* bits that differ from w[0] anywhere in w[0..m-1] */
+static uint64_t PayloadChanged(const uint64_t *w, int m)
+{
+#ifdef PAYLOAD_X86
+    if (__builtin_cpu_supports("avx2")) return PayloadChangedAvx2(w, m);
+#endif
+    uint64_t acc = 0;
+    for (int k = 1; k < m; k++)
+        acc |= w[k] ^ w[0];
+    return acc;
+}
+
+/* entropy of the first dlc[k] bytes of every word: bytes past the
+   DLC land in bin 256 instead of ending the loop early, and byte b
+   counts into hist[b & 3] so equal bytes do not queue on one counter */
+static double PayloadEntropy(const uint64_t *w, const unsigned char *dlc, int m)
+{
+    int hist[4][257], bytes = 0;
+    memset(hist, 0, sizeof hist);
+    for (int k = 0; k < m; k++){
+        uint64_t x = w[k];
+        int d = dlc[k];
+        for (int b = 0; b < 8; b++)
+            hist[b & 3][b < d ? (int)(x >> (8*b)) & 0xFF : 256]++;
+        bytes += d;
+    }
+    double e = 0;
+    for (int v = 0; v < 256 && bytes; v++){
+        int c = hist[0][v] + hist[1][v] + hist[2][v] + hist[3][v];
+        if (c){
+            double p = c / (double)bytes;
+            e -= p * log2(p);
+        }
+    }
+    return e;
+}
+
+/* Rows ordered by ID, then hyper_idx; hyper periods are hyper
+   seconds long (h if <= 0).  payload may be NULL.                 */
+int HyperFeatures(const struct Message *frames, const uint64_t *payload, int n,
+                  double hyper, struct HyperRow **out)
+{
+    struct IdPos  *ord = malloc((n ? n : 1) * sizeof *ord);
+    uint64_t      *w   = malloc((n + 1) * sizeof *w);       /* one period, packed */
+    unsigned char *dlc = malloc(n + 1);
+    int rows = 0, cap = 256;
+    *out = malloc(cap * sizeof **out);
+    if (!ord || !w || !dlc || !*out) { perror("malloc"); exit(EXIT_FAILURE); }
+    if (hyper <= 0) hyper = h;
+    for (int j = 0; j < n; j++){
+        ord[j].id  = id_to_long(frames[j].ID);
+        ord[j].pos = j;
+    }
+    qsort(ord, n, sizeof *ord, CmpIdPos);        /* stable: ties by frame */
+
+    for (int s = 0, e; s < n; s = e){
+        const struct Message *f0 = &frames[ord[s].pos];
+        long hIdx = (long)floor(f0->stamp / hyper);
+        double sum = 0, sq = 0, prev = f0->stamp;
+        long bits = f0->DLC*8 + 47;
+        for (e = s + 1; e < n && ord[e].id == ord[s].id; e++){
+            const struct Message *f = &frames[ord[e].pos];
+            if ((long)floor(f->stamp / hyper) != hIdx) break;
+            double gap = (f->stamp - prev) * 1e3;
+            sum += gap; sq += gap*gap;
+            prev  = f->stamp;
+            bits += f->DLC*8 + 47;
+        }
+        if (rows == cap){
+            cap *= 2;
+            *out = realloc(*out, cap * sizeof **out);
+            if (!*out) { perror("realloc"); exit(EXIT_FAILURE); }
+        }
+        struct HyperRow *r = &(*out)[rows++];
+        int gaps = e - s - 1;
+        memset(r, 0, sizeof *r);
+        memcpy(r->ID, f0->ID, IDLEN);
+        r->hyperIdx  = (int)hIdx;
+        r->nFrames   = e - s;
+        r->meanGapMs = gaps > 0 ? sum / gaps : 0;
+        r->stdGapMs  = gaps > 1 ? sqrt(fmax(0, (sq - sum*sum/gaps) / (gaps - 1))) : 0;
+        r->utilBits  = bits;
+        if (!payload) continue;
+
+        /* gather the period's payloads, preceded by the ID's previous frame */
+        int pre = s > 0 && ord[s-1].id == ord[s].id, m = 0, sent = 8;
+        if (pre) w[m++] = payload[ord[s-1].pos];
+        for (int k = s; k < e; k++){
+            int d = frames[ord[k].pos].DLC;
+            dlc[m]   = d < 0 ? 0 : d > 8 ? 8 : d;
+            if (dlc[m] < sent) sent = dlc[m];
+            w[m++]   = payload[ord[k].pos];
+        }
+        uint64_t changed = PayloadChanged(w + pre, e - s);
+        r->byteEntropy = PayloadEntropy(w + pre, dlc + pre, e - s);
+        r->bitFlipRate = m > 1 ? PayloadFlips(w, m) / (64.0 * (m - 1)) : 0;
+        for (int b = 0; b < sent; b++)            /* bytes past the DLC are not data */
+            if (!((changed >> (8*b)) & 0xFF)) r->constMask |= 1u << b;
+    }
+    free(ord); free(w); free(dlc);
+    return rows;
+}
+
+/* otids_hyper_dataset.csv columns (labels are added by make_dataset.py) */
+int SaveHyperFeaturesCSV(const char *path, const struct HyperRow *r, int rows)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); return 0; }
+    setvbuf(f, NULL, _IOFBF, SINK_BUFSZ);
+    fprintf(f, "Identifier,hyper_idx,n_frames,mean_gap_ms,std_gap_ms,util_bits,"
+               "byte_entropy,bit_flip_rate,const_mask\n");
+    for (int i = 0; i < rows; i++)                /* "0191", as in make_dataset.py */
+        fprintf(f, "%04lX,%d,%d,%.6f,%.6f,%ld,%.4f,%.6f,%u\n", id_to_long(r[i].ID), r[i].hyperIdx,
+                r[i].nFrames, r[i].meanGapMs, r[i].stdGapMs, r[i].utilBits,
+                r[i].byteEntropy, r[i].bitFlipRate, r[i].constMask);
+    fclose(f);
+    return 1;
+}
+
+/* ─────────────  online timing detector (--detect)  ────────── */
+/* Streams the merged logs frame by frame and checks every frame
+   the moment it is parsed.  Per ID the state is fixed: last arrival,
+   an EWMA of gap/period and a two-sided CUSUM on that ratio, with
+   the configured period (ECUIDPeriodsArr) and a jitter allowance j
+   (fraction of the period, --jitter):
+
+     early     gap < (1-3j)*P: injected frame (DoS, impersonation)
+     missing   gap > (1.5+j)*P: frames suppressed in between
+     overdue   same, found by a round-robin deadline check while the
+               ID is still silent (one configured ID per frame)
+     drift     CUSUM of (1-r)-j or (r-1)-j above DET_CUSUM_H: a slow
+               rate change that no single gap gives away
+     unknown   any frame of an ID that is not configured (a flood
+               keeps alerting; n counts its frames)
+
+   Alerts bypass the sink buffering: both sinks are flushed after
+   every alert, so a live feed (stdin) reports as it happens.
+
+   The table is open-addressed and never grows: IDs beyond its
+   capacity are only counted.                                      */
+#define DET_SLOTS    4096
+#define DET_CUSUM_H  3.0
+#define DET_EWMA_A   (1.0/16)
+
+struct IdTiming{
+    long   id;              /* -1: free slot                      */
+    char   ID[IDLEN];
+    float  period;          /* 0: not configured                  */
+    double last;            /* previous arrival (s)               */
+    double ewma;            /* gap / period                       */
+    double cusumLo, cusumHi;
+    long   frames, early, missing, drift;
+    int    overdue;         /* deadline alert raised for this gap */
+};
+
+struct Detector{
+    struct IdTiming slot[DET_SLOTS];
+    int    *known;          /* slots of the configured IDs        */
+    int     nKnown, rr, used;
+    double  jitter;
+    long    untracked, alerts;
+};
+
+double detJitter = 0.1;
+
+static struct IdTiming *DetectSlot(struct Detector *d, long id, const char *ID)
+{
+    unsigned i = (unsigned)(id * 2654435761u) & (DET_SLOTS - 1);
+    while (d->slot[i].id != id){
+        if (d->slot[i].id == -1){
+            if (d->used >= DET_SLOTS * 3 / 4) return NULL;       /* table full */
+            d->used++;
+            d->slot[i].id = id;
+            memcpy(d->slot[i].ID, ID, IDLEN);
+            d->slot[i].ewma = 1;
+            return &d->slot[i];
+        }
+        i = (i + 1) & (DET_SLOTS - 1);
+    }
+    return &d->slot[i];
+}
+
+void DetectorInit(struct Detector *d, double jitter)
+{
+    memset(d, 0, sizeof *d);
+    for (int i = 0; i < DET_SLOTS; i++) d->slot[i].id = -1;
+    d->jitter = jitter;
+    d->known  = malloc((ECUCountVar ? ECUCountVar : 1) * sizeof *d->known);
+    if (!d->known) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < ECUCountVar; i++){
+        char ID[IDLEN];
+        if (ECUIDsArr[i][0]=='0' && (ECUIDsArr[i][1]=='x' || ECUIDsArr[i][1]=='X'))
+            strncpy(ID, ECUIDsArr[i], IDLEN-1);
+        else
+            snprintf(ID, IDLEN, "0x%s", ECUIDsArr[i]);
+        ID[IDLEN-1] = '\0';
+        struct IdTiming *s = DetectSlot(d, id_to_long(ID), ID);
+        if (s && !s->period){
+            s->period = ECUIDPeriodsArr[i];
+            d->known[d->nKnown++] = s - d->slot;
+        }
+    }
+}
+
+static void DetectAlert(struct Detector *d, const struct IdTiming *s, const char *type,
+                        double t, double ratio, long n)
+{
+    d->alerts++;
+    REPORT(REP_ROUND, "%.6f  %-7s %-8s gap/period %.3f  n %ld\n", t, s->ID, type, ratio, n);
+    JSONL("{\"event\":\"alert\",\"type\":\"%s\",\"id\":\"%s\",\"t\":%.6f,"
+          "\"ratio\":%.4f,\"n\":%ld}\n", type, s->ID, t, ratio, n);
+    SinkFlush(&repSink);
+    SinkFlush(&jsonSink);
+}
+
+/* O(1) per frame */
+void DetectFrame(struct Detector *d, const struct Message *f)
+{
+    double t = f->stamp, j = d->jitter;
+    struct IdTiming *s = DetectSlot(d, id_to_long(f->ID), f->ID);
+    if (!s) { d->untracked++; return; }
+
+    if (!s->period)
+        DetectAlert(d, s, "unknown", t, 0, ++s->frames);
+    else if (s->frames++ > 0){
+        double r = (t - s->last) / s->period;
+        s->ewma    += DET_EWMA_A * (r - s->ewma);
+        s->cusumLo  = fmax(0, s->cusumLo + (1 - r) - j);
+        s->cusumHi  = fmax(0, s->cusumHi + (r - 1) - j);
+        if (r < 1 - 3*j){
+            s->early++;
+            DetectAlert(d, s, "early", t, r, s->early);
+        }
+        else if (s->cusumLo > DET_CUSUM_H){
+            s->drift++; s->cusumLo = 0;
+            DetectAlert(d, s, "drift", t, s->ewma, s->drift);
+        }
+        if (r > 1.5 + j){
+            long lost = lround(r) - 1 > 0 ? lround(r) - 1 : 1;
+            s->missing += lost;
+            if (!s->overdue) DetectAlert(d, s, "missing", t, r, lost);
+        }
+        else if (s->cusumHi > DET_CUSUM_H){
+            s->drift++; s->cusumHi = 0;
+            DetectAlert(d, s, "drift", t, s->ewma, s->drift);
+        }
+    }
+    s->last    = t;
+    s->overdue = 0;
+
+    /* deadline check: suppression shows up before the ID speaks again */
+    if (d->nKnown){
+        struct IdTiming *q = &d->slot[d->known[d->rr]];
+        d->rr = (d->rr + 1) % d->nKnown;
+        if (q->frames && !q->overdue && t - q->last > (1.5 + j) * q->period){
+            q->overdue = 1;
+            DetectAlert(d, q, "overdue", t, (t - q->last) / q->period, 1);
+        }
+    }
+}
+
+/* --detect: run the detector over the merged logs without storing them */
+long DetectStream(const struct LogSource *src, int k, double jitter)
+{
+    struct Detector *d = malloc(sizeof *d);
+    struct LogMerge  m;
+    struct Message   f;
+    long n = 0;
+    if (!d) { perror("malloc"); exit(EXIT_FAILURE); }
+    DetectorInit(d, jitter);
+    if (!LogMergeOpen(&m, src, k, 0)) { LogMergeClose(&m); free(d->known); free(d); return -1; }
+
+    double t0 = NowSec();
+    while (LogMergeNext(&m, &f, NULL)){
+        DetectFrame(d, &f);
+        n++;
+    }
+    double sec = NowSec() - t0;
+    LogMergeClose(&m);
+
+    REPORT(REP_SUMMARY, "\nTiming detector: %ld frames, %ld alerts, jitter %.2f\n",
+           n, d->alerts, jitter);
+    REPORT(REP_SUMMARY, "%-8s %9s %10s %8s %8s %8s %8s\n",
+           "ID", "period", "frames", "early", "missing", "drift", "ewma");
+    for (int i = 0; i < DET_SLOTS; i++){
+        const struct IdTiming *s = &d->slot[i];
+        if (s->id == -1 || !s->frames) continue;
+        if (!s->period)
+            REPORT(REP_SUMMARY, "%-8s %9s %10ld %8s %8s %8s %8s\n",
+                   s->ID, "unknown", s->frames, "-", "-", "-", "-");
+        else if (s->early || s->missing || s->drift || verbosity >= REP_ROUND)
+            REPORT(REP_SUMMARY, "%-8s %9.4f %10ld %8ld %8ld %8ld %8.3f\n", s->ID, s->period,
+                   s->frames, s->early, s->missing, s->drift, s->ewma);
+    }
+    if (d->untracked) REPORT(REP_SUMMARY, "%ld frames of untracked IDs (table full)\n", d->untracked);
+    REPORT(REP_SUMMARY, "%.3f s read + detect, %.0f frames/s\n",
+           sec, sec > 0 ? n / sec : 0);
+    free(d->known); free(d);
+    return n;
+}
+
+/* ─────────────  library interface (-DSCHED_LIB)  ──────────── */
+/* Built with  gcc -std=c11 -O2 -shared -fPIC -DSCHED_LIB
+   new_obfuscation.c -o libsched_attack.so -lm  the analyser is a
+   shared library for sched_native.py.  Every result stays in the
+   buffer the analyser filled; Python wraps it as a NumPy view and
+   hands it back to the matching sa_free_* when the view is dropped.
+   sa_layout() publishes the struct offsets so the wrapper never
+   hard-codes them.                                                */
+
+enum { LAY_MSG_SIZE, LAY_MSG_ID, LAY_MSG_DLC, LAY_MSG_TXTIME, LAY_MSG_STAMP,
+       LAY_MSG_PERIOD, LAY_MSG_COUNT, LAY_MSG_ATKWINLEN, LAY_MSG_READCOUNT,
+       LAY_MSG_SKIPLIMIT, LAY_MSG_INSTANCES, LAY_MSG_PATTERN,
+       LAY_INS_SIZE, LAY_INS_INDEX, LAY_INS_ATKWINLEN, LAY_INS_ATKWINCOUNT,
+       LAY_INS_ATTACKABLE, LAY_INS_ATKWIN, LAY_INS_INSWIN,
+       LAY_HYP_SIZE, LAY_HYP_ID, LAY_HYP_IDX, LAY_HYP_NFRAMES,
+       LAY_HYP_MEANGAP, LAY_HYP_STDGAP, LAY_HYP_UTILBITS,
+       LAY_HYP_ENTROPY, LAY_HYP_FLIPRATE, LAY_HYP_CONSTMASK,
+       LAY_IDLEN, LAY_COUNT };
+
+int sa_layout(long *out, int n)
+{
+    long lay[LAY_COUNT] = {
+        sizeof(struct Message), offsetof(struct Message, ID),
+        offsetof(struct Message, DLC), offsetof(struct Message, txTime),
+        offsetof(struct Message, stamp), offsetof(struct Message, periodicity),
+        offsetof(struct Message, count), offsetof(struct Message, atkWinLen),
+        offsetof(struct Message, readCount), offsetof(struct Message, skipLimit),
+        offsetof(struct Message, instances), offsetof(struct Message, pattern),
+        sizeof(struct Instance), offsetof(struct Instance, index),
+        offsetof(struct Instance, atkWinLen), offsetof(struct Instance, atkWinCount),
+        offsetof(struct Instance, attackable), offsetof(struct Instance, atkWin),
+        offsetof(struct Instance, insWin),
+        sizeof(struct HyperRow), offsetof(struct HyperRow, ID),
+        offsetof(struct HyperRow, hyperIdx), offsetof(struct HyperRow, nFrames),
+        offsetof(struct HyperRow, meanGapMs), offsetof(struct HyperRow, stdGapMs),
+        offsetof(struct HyperRow, utilBits), offsetof(struct HyperRow, byteEntropy),
+        offsetof(struct HyperRow, bitFlipRate), offsetof(struct HyperRow, constMask),
+        IDLEN };
+    if (n > LAY_COUNT) n = LAY_COUNT;
+    memcpy(out, lay, n * sizeof *out);
+    return LAY_COUNT;
+}
+
+/* k logs merged by timestamp (offsets may be NULL); payload != NULL also
+   keeps the packed D0..D7 column.  Returns the frame count.            */
+int sa_load(const char *const *paths, const double *offsets, int k,
+            struct Message **frames, uint64_t **payload)
+{
+    struct LogSource *src = calloc(k, sizeof *src);
+    if (!src) { perror("calloc"); exit(EXIT_FAILURE); }
+    for (int f = 0; f < k; f++){
+        src[f].path   = paths[f];
+        src[f].offset = offsets ? offsets[f] : 0;
+    }
+    *frames = NULL;
+    if (payload) *payload = NULL;
+    int n = InitializeCANTrafficMerged(frames, payload, src, k);
+    free(src);
+    return n;
+}
+
+void sa_free(void *p)
+{
+    free(p);
+}
+
+/* One analysis pass over frames[] for the given IDs, as round 0 of
+   the executable: instances labelled attackable, per-ID atkWinLen
+   averaged.  Returns the candidate table (free with sa_free_candidates). */
+struct Message *sa_analyze(struct Message *frames, int n, const char *const *ids,
+                           const float *periods, const int *skips, int nIds)
+{
+    struct Message *c = calloc(nIds, sizeof *c);
+    if (!c) { perror("calloc"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < nIds; i++){
+        if (ids[i][0]=='0' && (ids[i][1]=='x' || ids[i][1]=='X'))
+            strncpy(c[i].ID, ids[i], IDLEN-1);
+        else
+            snprintf(c[i].ID, IDLEN, "0x%s", ids[i]);
+        c[i].periodicity = periods[i];
+        c[i].count       = ceil(h/c[i].periodicity);
+        c[i].skipLimit   = skips ? skips[i] : 2;
+        c[i].instances   = calloc(c[i].count, sizeof(struct Instance));
+        c[i].sortedASP   = calloc(c[i].count, sizeof(int));
+        c[i].pattern     = calloc(c[i].count, sizeof(int));
+        if (!c[i].instances || !c[i].sortedASP || !c[i].pattern)
+            { perror("calloc"); exit(EXIT_FAILURE); }
+        for (int j = 0; j < c[i].count; j++){
+            c[i].instances[j].index = j;
+            c[i].pattern[j] = 1;
+        }
+    }
+    AnalyzeCANTraffic(frames, n, &c, nIds);
+    for (int i = 0; i < nIds; i++){
+        long sum = 0;
+        for (int j = 0; j < c[i].count; j++){
+            struct Instance *in = &c[i].instances[j];
+            in->attackable = in->atkWinLen >= minAtkWinLen;
+            sum += in->atkWinLen;
+        }
+        c[i].atkWinLen = sum / c[i].count;
+    }
+    return c;
+}
+
+void sa_free_candidates(struct Message *c, int n)
+{
+    for (int i = 0; i < n; i++){
+        for (int j = 0; j < c[i].count; j++){
+            free(c[i].instances[j].atkWin);
+            free(c[i].instances[j].insWin);
+        }
+        if (c[i].tAtkWinLen > 0){ free(c[i].tAtkWin); free(c[i].tInsWin); }
+        free(c[i].instances); free(c[i].sortedASP);
+        free(c[i].pattern);   free(c[i].zeroRun);
+    }
+    free(c);
+}
+
+/* HyperFeatures() for Python (payload may be NULL); free with sa_free */
+int sa_hyper_features(const struct Message *frames, const uint64_t *payload, int n,
+                      double hyper, struct HyperRow **out)
+{
+    return HyperFeatures(frames, payload, n, hyper, out);
+}
+
+#ifndef SCHED_LIB
+int main(int argc,char **argv)
+{
+    if(argc>=3 && strcmp(argv[1],"--export")==0)      /* results file -> CSV */
+        return ExportResultsCSV(argv[2], argc>3 ? argv[3] : "final_candidates.csv") ? 0 : 1;
+    if(argc<2){
+        puts("usage: ./sched_attack <csv[@offset]> [-m csv[@offset]]... [-i id1,id2] [-v level]\n"
+             "                      [-j out.jsonl] [-c cachedir] [-o results.awr] [--csv]\n"
+             "                      [-k ckptfile] [-e hyperperiods] [--resume] [-p greedy|optimal]\n"
+             "                      [--replay] [-f features.csv]\n"
+             "       ./sched_attack <csv|-> [-m csv]... --detect [--jitter j] [-i ids] [-v 1] [-j alerts.jsonl]\n"
+             "       ./sched_attack --export results.awr [out.csv]");
+        return 1;
+    }
+    AddLogSource(argv[1]);
+    const char *jsonFile=NULL, *cacheDir=NULL, *resFile="final_candidates.awr", *featFile=NULL;
+    int resume=0, doReplay=0, csvOut=0, detect=0;
+    static const struct option longOpts[]={
+        {"resume",           no_argument,       NULL, 'r'},
+        {"checkpoint",       required_argument, NULL, 'k'},
+        {"checkpoint-every", required_argument, NULL, 'e'},
+        {"policy",           required_argument, NULL, 'p'},
+        {"replay",           no_argument,       NULL, 'R'},
+        {"csv",              no_argument,       NULL, 'C'},
+        {"detect",           no_argument,       NULL, 'D'},
+        {"jitter",           required_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt; while((opt=getopt_long(argc-1,argv+1,"i:v:j:c:k:e:p:m:o:f:",longOpts,NULL))!=-1){
         if(opt=='i'){ useDynamic=1; parse_id_list(optarg); }
+        else if(opt=='m') AddLogSource(optarg);
+        else if(opt=='v') verbosity=atoi(optarg);
+        else if(opt=='j') jsonFile=optarg;
+        else if(opt=='c') cacheDir=optarg;
+        else if(opt=='k') ckpt.path=optarg;
+        else if(opt=='e') ckpt.every=atoi(optarg) > 0 ? atoi(optarg) : 1;
+        else if(opt=='r') resume=1;
+        else if(opt=='R') doReplay=1;
+        else if(opt=='o') resFile=optarg;
+        else if(opt=='C') csvOut=1;
+        else if(opt=='f') featFile=optarg;
+        else if(opt=='D') detect=1;
+        else if(opt=='J') detJitter=atof(optarg);
+        else if(opt=='p'){
+            if      (strcmp(optarg,"greedy")==0)  policyMode = POLICY_GREEDY;
+            else if (strcmp(optarg,"optimal")==0) policyMode = POLICY_OPTIMAL;
+            else { fprintf(stderr,"unknown policy '%s' (greedy|optimal)\n", optarg); return 1; }
+        }
+    }
+    if(resume && !ckpt.path) ckpt.path="sched_attack.ckpt";
 
     if(useDynamic){
         fill_periods();
-        ECUIDsArr   = (const char**)dynIDs;
+        for(int d=0;d<dynCount;d++) dynIDPtrs[d]=dynIDs[d];
+        ECUIDsArr   = dynIDPtrs;
         ECUIDPeriodsArr  = dynPeriods;
         ctrlSkipLimitArr = dynSkip;
         ECUCountVar      = dynCount;
     }
 
+    SinkOpen(&repSink, stdout);
+    if(jsonFile){
+        FILE *jf=fopen(jsonFile,resume ? "a" : "w");   /* resume continues the stream */
+        if(!jf){ perror(jsonFile); return 1; }
+        SinkOpen(&jsonSink, jf);
+    }
+    for(int f=0;f<logCount && !detect && (ckpt.path || cacheDir);f++)
+        if(strcmp(logSrc[f].path,"-")==0){    /* keys hash the files: stdin has none */
+            fprintf(stderr,"-c, -k and --resume need files, not stdin\n");
+            SinkClose(&jsonSink); SinkClose(&repSink);
+            return 1;
+        }
+    if(detect){                               /* streaming mode, no analysis */
+        long n=DetectStream(logSrc,logCount,detJitter);
+        SinkClose(&jsonSink);
+        SinkClose(&repSink);
+        return n<0;
+    }
+
     int i = 0, sum = 0, j = 0, k = 0, l = 0;
     int CANCount = 0, ifSkip = 0, insToSkipObf1 = 0, insToSkipObf2 = 0, initDectec = 0;
     float smallestPeriod = 0;
@@ -781,29 +2840,86 @@ int main(int argc,char **argv)
 
     /* allocate and run */
     struct Message *traffic=NULL,*cand=calloc(ECUCountVar,sizeof(struct Message));
-    CANCount = InitializeCANTraffic(&traffic,csvFile);
-    printf("Loaded %d packets from CSV\n", CANCount);       /* ← ① */
-    if (CANCount <= 0) { puts("Nothing to analyse – abort"); return 1; }
+    uint64_t *payload=NULL;                 /* D0..D7, only kept for -f */
+    CANCount = InitializeCANTrafficMerged(&traffic,featFile ? &payload : NULL,logSrc,logCount);
+    REPORT(REP_SUMMARY,"Loaded %d packets from CSV\n", CANCount);       /* ← ① */
+    if (logCount > 1) REPORT(REP_SUMMARY,"  (%d logs merged by timestamp)\n", logCount);
+    if (CANCount <= 0){
+        REPORT(REP_SUMMARY,"Nothing to analyse – abort\n");
+        SinkClose(&repSink); SinkClose(&jsonSink);
+        return 1;
+    }
+    if (featFile){
+        struct HyperRow *rows = NULL;
+        int nRows = HyperFeatures(traffic, payload, CANCount, h, &rows);
+        if (SaveHyperFeaturesCSV(featFile, rows, nRows))
+            REPORT(REP_SUMMARY,"Wrote %d ID/hyper-period feature rows to %s\n", nRows, featFile);
+        free(rows); free(payload);
+    }
     InitializeECU(&cand);
-    printf("First ECU ID: %s\n", cand[0].ID);               /* ← ② */
-    printf("First packet ID: %s\n", traffic[0].ID);         /* ← ③ */
+
+    /* last reported per-candidate state, so -j only carries changes */
+    int *prevAtk = malloc(ECUCountVar*sizeof(int));
+    int *prevLen = malloc(ECUCountVar*sizeof(int));
+    if(!prevAtk || !prevLen){ perror("malloc"); exit(EXIT_FAILURE); }
+    for (i = 0; i < ECUCountVar; i++) prevAtk[i] = prevLen[i] = -1;
+
+    unsigned long long traceHash = 0;
+    if ((ckpt.path || cacheDir) && !TraceFingerprint(logSrc, logCount, &traceHash)){
+        fprintf(stderr, "no trace key for -c/-k/--resume\n");
+        SinkClose(&repSink); SinkClose(&jsonSink);
+        return 1;
+    }
+    if (ckpt.path){
+        ckpt.traceHash = traceHash;
+        if (resume && !ResumeCheckpoint(cand, ECUCountVar, &l, prevAtk, prevLen)){
+            SinkClose(&repSink); SinkClose(&jsonSink);
+            return 1;
+        }
+    }
+    REPORT(REP_SUMMARY,"First ECU ID: %s\n", cand[0].ID);               /* ← ② */
+    REPORT(REP_SUMMARY,"First packet ID: %s\n", traffic[0].ID);         /* ← ③ */
+
+    struct PolicyEngine pe;
+    PolicyEngineInit(&pe, ECUCountVar);
+    double greedySec = 0;
 
     while (l <= 10)
     {
-        printf("\nAnalyzing the CAN traffic.......................");
-        AnalyzeCANTraffic(traffic, CANCount, &cand);
+        int roundAtk = 0, roundSkips = 0;
+        if (ckpt.path) SinkFlush(&jsonSink);   /* stream on disk up to the snapshot */
+        if (ckpt.path && CheckpointBase(cand, ECUCountVar, l, ckpt.resumeFrame,
+                                        prevAtk, prevLen) != 0){
+            fprintf(stderr, "checkpointing disabled\n");
+            ckpt.path = NULL;
+        }
+        REPORT(REP_CAND,"\nAnalyzing the CAN traffic.......................");
+        if (l == 0 && cacheDir && ckpt.resumeFrame == 0)
+            AnalyzeFirstPassCached(traffic, CANCount, cand, ECUCountVar,
+                                   traceHash, cacheDir);
+        else
+            AnalyzeCANTraffic(traffic, CANCount, &cand, ECUCountVar);
 
         /* ---------- compute avg attack-window & label ------------- */
         for (i = 0; i < ECUCountVar; i++)
         {
+            int atk = 0;
             sum = 0;
             for (j = 0; j < cand[i].count; j++)
             {
                 cand[i].instances[j].attackable =
                     (cand[i].instances[j].atkWinLen >= minAtkWinLen);
+                atk += cand[i].instances[j].attackable;
                 sum += cand[i].instances[j].atkWinLen;
             }
             cand[i].atkWinLen = sum / cand[i].count;
+            roundAtk += atk;
+            if (atk != prevAtk[i] || cand[i].atkWinLen != prevLen[i])
+                JSONL("{\"round\":%d,\"event\":\"stats\",\"id\":\"%s\","
+                      "\"attackable\":%d,\"count\":%d,\"atkWinLen\":%d}\n",
+                      l, cand[i].ID, atk, cand[i].count, cand[i].atkWinLen);
+            prevAtk[i] = atk;
+            prevLen[i] = cand[i].atkWinLen;
         }
 
         /* ---------- print & sort instances ------------------------ */
@@ -811,92 +2927,117 @@ int main(int argc,char **argv)
         {
             InsSortByAtkWinLen(&cand[i].instances, 0, cand[i].count - 1);
 
-            printf("\n Candidate ID = %s", cand[i].ID);
-            printf("\n--------------------------------------------------");
-            for (j = 0; j < cand[i].count; j++)
+            if (verbosity < REP_CAND) continue;
+            REPORT(REP_CAND,"\n Candidate ID = %s", cand[i].ID);
+            REPORT(REP_CAND,"\n--------------------------------------------------");
+            for (j = 0; j < cand[i].count && verbosity >= REP_INST; j++)
             {
-                printf("\n %d: Instance = %d: attack win len = %d, attack win count = %d",
+                REPORT(REP_INST,"\n %d: Instance = %d: attack win len = %d, attack win count = %d",
                     j, cand[i].instances[j].index,
                     cand[i].instances[j].atkWinLen,
                     cand[i].instances[j].atkWinCount);
 
-                printf("\n Attack window:");
+                if (verbosity < REP_WINDOW) continue;
+                REPORT(REP_WINDOW,"\n Attack window:");
                 for (k = 0; k < cand[i].instances[j].atkWinCount; k++)
-                    printf("%d(instance=%d)  ",
+                    REPORT(REP_WINDOW,"%d(instance=%d)  ",
                         cand[i].instances[j].atkWin[k],
                         cand[i].instances[j].insWin[k]);
             }
-            printf("\n Pattern: ");
+            REPORT(REP_CAND,"\n Pattern: ");
             for (j = 0; j < cand[i].count; j++)
-                printf("%d ", cand[i].pattern[j]);
-            printf("\n===========================================================================================");
+                REPORT(REP_CAND,"%d ", cand[i].pattern[j]);
+            REPORT(REP_CAND,"\n===========================================================================================");
         }
 
         /* ---------- obfuscation policies -------------------------- */
-        printf("\n Obfuscation policy initiated....................");
+        REPORT(REP_CAND,"\n Obfuscation policy initiated....................");
+        double t0 = NowSec();
+        PolicyEngineBuild(&pe, cand);
         for (i = 0; i < ECUCountVar; i++)
         {
             ifSkip = 0; insToSkipObf1 = 0; insToSkipObf2 = 0; j = 0;
 
-            printf("\nCandidate ID = %s", cand[i].ID);
-            printf("\n Checking obfuscation 1");
-            while (j < cand[i].count &&
-                (!cand[i].instances[j].attackable ||
-                !cand[i].pattern[cand[i].instances[j].index]))
+            REPORT(REP_CAND,"\nCandidate ID = %s", cand[i].ID);
+            REPORT(REP_CAND,"\n Checking obfuscation 1");
+            /* sorted by atkWinLen, so the attackable ones are a prefix */
+            while (j < cand[i].count && cand[i].instances[j].attackable &&
+                !cand[i].pattern[cand[i].instances[j].index])
                 j++;
+            if (j < cand[i].count && !cand[i].instances[j].attackable)
+                j = cand[i].count;
 
-            printf("\n sorted order = %d", j);
+            REPORT(REP_CAND,"\n sorted order = %d", j);
 
             if (j < cand[i].count)
             {
                 insToSkipObf1 = cand[i].instances[j].index;
-                ifSkip = IfSkipPossible(cand[i].pattern, cand[i].count,
-                                        cand[i].skipLimit, insToSkipObf1);
+                ifSkip = IfSkipPossibleIdx(&cand[i], cand[i].skipLimit, insToSkipObf1);
+            }
+            if (ifSkip){                /* obf-1 succeeded */
+                roundSkips++;
+                JSONL("{\"round\":%d,\"event\":\"skip\",\"policy\":1,"
+                      "\"id\":\"%s\",\"instance\":%d}\n",
+                      l, cand[i].ID, insToSkipObf1);
+                continue;
             }
-            if (ifSkip) continue;     /* obf-1 succeeded */
 
             /* ------ obfuscation 2 --------------------------------- */
-            printf("\n Checking obfuscation 2");
-            for (j = 0; j < i && !ifSkip; j++)
+            REPORT(REP_CAND,"\n Checking obfuscation 2");
+            int nHit = PolicyWindowHits(&pe,
+                                        cand[i].instances[insToSkipObf1].atkWin,
+                                        cand[i].instances[insToSkipObf1].atkWinCount, i);
+            for (int h2 = 0; h2 < nHit && !ifSkip; h2++)
             {
-                insToSkipObf2 = CheckMembership(
-                    cand[i].instances[insToSkipObf1].atkWin,
-                    cand[i].instances[insToSkipObf1].atkWinCount,
-                    id_to_long(cand[j].ID));
-
-                if (insToSkipObf2 >= 0)
-                    ifSkip = IfSkipPossible(cand[j].pattern, cand[j].count,
-                                            ctrlSkipLimitArr[j], insToSkipObf2);
+                j = pe.hitPos[h2];
+                insToSkipObf2 = pe.hitSlot[j];
+                ifSkip = IfSkipPossibleIdx(&cand[j], ctrlSkipLimitArr[j], insToSkipObf2);
+                if (ifSkip == 1){           /* 2: already skipped, nothing new */
+                    roundSkips++;
+                    JSONL("{\"round\":%d,\"event\":\"skip\",\"policy\":2,"
+                          "\"id\":\"%s\",\"instance\":%d,\"for\":\"%s\"}\n",
+                          l, cand[j].ID, insToSkipObf2, cand[i].ID);
+                }
             }
 
             /* ------ obfuscation 3 --------------------------------- */
             if (!ifSkip)
             {
-                printf("\n Checking obfuscation 3");
-                for (k = i - 1; k >= 0; k--)
-                    if (cand[i].periodicity != cand[k].periodicity) break;
-
-                if (k != i - 1)
+                REPORT(REP_CAND,"\n Checking obfuscation 3");
+                k = pe.grpStart[i];
+                if (k != i && pe.seen[k] == pe.query)   /* cand[k] in window */
                 {
-                    k++;
-                    if (cand[i].periodicity == cand[k].periodicity &&
-                        CheckMembership(
-                            cand[i].instances[insToSkipObf1].atkWin,
-                            cand[i].instances[insToSkipObf1].atkWinCount,
-                            id_to_long(cand[k].ID)) >= 0)
-                    {
-                        struct Message temp = cand[k];
-                        cand[k] = cand[i];
-                        cand[i] = temp;
-                    }
+                    JSONL("{\"round\":%d,\"event\":\"swap\",\"policy\":3,"
+                          "\"id\":\"%s\",\"with\":\"%s\"}\n",
+                          l, cand[i].ID, cand[k].ID);
+                    PolicySwap(&pe, cand, i, k);
                 }
             }
         }
+        greedySec += NowSec() - t0;
+        REPORT(REP_ROUND,"\nround %2d: attackable instances = %d, new skips = %d",
+               l, roundAtk, roundSkips);
         l++;
     }
-
-    SaveFinalCandidatesCSV(cand,ECUCountVar);
+    REPORT(REP_ROUND,"\n");
+
+    if (policyMode == POLICY_OPTIMAL)
+        ApplySolver(traffic, CANCount, cand, ECUCountVar, l, greedySec);
+    if (doReplay)
+        ReportReplay(traffic, CANCount, cand, ECUCountVar, l);
+    ReportSummary(cand,ECUCountVar,l);
+    if (SaveResults(resFile,cand,ECUCountVar,l) && csvOut)
+        ExportResultsCSV(resFile,"final_candidates.csv");
     SaveIDSummaryCSV(cand,ECUCountVar);
+    if (ckpt.fp){                          /* finished: nothing to resume */
+        fclose(ckpt.fp);
+        remove(ckpt.path);
+    }
+    SinkClose(&jsonSink);
+    SinkClose(&repSink);
+    PolicyEngineFree(&pe);
+    free(prevAtk); free(prevLen);
     free(cand); free(traffic);
     return 0;
 }
+#endif /* SCHED_LIB */
@@ -0,0 +1,280 @@
+#!/usr/bin/env python3
+"""
+sched_native.py
+────────────────────
+NumPy front end to the native attack-window analyser
+(Hide-n-Seek/new_obfuscation.c built as a shared library).
+
+• Build
+    gcc -std=c11 -O2 -shared -fPIC -DSCHED_LIB \\
+        Hide-n-Seek/new_obfuscation.c -o Hide-n-Seek/libsched_attack.so -lm
+  The library is looked up in $SCHED_ATTACK_LIB, next to this file,
+  then in Hide-n-Seek/.
+• API
+    frames = load_frames(["a.csv", "b.csv"], offsets=[0, -0.004])
+             → ID, DLC, txTime, stamp  (one row per frame, merged by time)
+    frames, payload = load_frames("a.csv", payload=True)
+             → payload: uint64 per frame, byte Di in bits 8i..8i+7
+    res    = analyze(frames, ["00A0", "0230"], [0.010, 0.020], skips=[2, 1])
+             res.candidates     → ID, periodicity, count, atkWinLen, ...
+             res.instances(i)   → index, atkWinLen, atkWinCount, attackable
+             res.atk_win(i, j) / res.ins_win(i, j)   → int32
+    hyper  = hyper_features(frames, H=5.0, payload=payload)
+             → ID, hyper_idx, n_frames, mean_gap_ms, std_gap_ms, util_bits,
+               byte_entropy, bit_flip_rate, const_mask   (0 without payload)
+    set_params(h=5, min_atk_win_len=111, min_dlc=7, bus_speed=500)
+    rs     = Results("final_candidates.awr")        # sched_attack -o output
+             rs[i]              → that candidate's instance rows (memmap slices)
+             rs.windows(i, j)   → (atkWin, insWin) of its row j (rank, not slot)
+
+Every array is a view on memory the C code allocated (or on the
+mapped results file) – nothing is copied.  A view keeps its owner
+alive; the buffer goes back to the library once the last view on it
+is gone.  Only hyper_frame() copies, into a DataFrame with the
+otids_hyper_dataset.csv column names.
+"""
+import ctypes, os, pathlib
+import numpy as np
+
+# ──────────────────────────────────────────────────────────────────────────
+def _find_lib() -> str:
+    here = pathlib.Path(__file__).resolve().parent
+    for p in (os.environ.get("SCHED_ATTACK_LIB"),
+              here / "libsched_attack.so",
+              here / "Hide-n-Seek" / "libsched_attack.so"):
+        if p and pathlib.Path(p).exists():
+            return str(p)
+    raise OSError("libsched_attack.so not found – build it (see module doc) "
+                  "or set SCHED_ATTACK_LIB")
+
+
+_lib = ctypes.CDLL(_find_lib())
+_vp, _int = ctypes.c_void_p, ctypes.c_int
+
+_lib.sa_layout.argtypes          = [ctypes.POINTER(ctypes.c_long), _int]
+_lib.sa_load.argtypes            = [ctypes.POINTER(ctypes.c_char_p),
+                                    ctypes.POINTER(ctypes.c_double), _int,
+                                    ctypes.POINTER(_vp), ctypes.POINTER(_vp)]
+_lib.sa_free.argtypes            = [_vp]
+_lib.sa_analyze.argtypes         = [_vp, _int, ctypes.POINTER(ctypes.c_char_p),
+                                    ctypes.POINTER(ctypes.c_float),
+                                    ctypes.POINTER(_int), _int]
+_lib.sa_analyze.restype          = _vp
+_lib.sa_free_candidates.argtypes = [_vp, _int]
+_lib.sa_hyper_features.argtypes  = [_vp, _vp, _int, ctypes.c_double, ctypes.POINTER(_vp)]
+
+# struct layout as the C compiler laid it out (order = LAY_* enum)
+_LAY_NAMES = """msg_size msg_id msg_dlc msg_txtime msg_stamp msg_period msg_count
+    msg_atkwinlen msg_readcount msg_skiplimit msg_instances msg_pattern
+    ins_size ins_index ins_atkwinlen ins_atkwincount ins_attackable ins_atkwin
+    ins_inswin hyp_size hyp_id hyp_idx hyp_nframes hyp_meangap hyp_stdgap
+    hyp_utilbits hyp_entropy hyp_fliprate hyp_constmask idlen""".split()
+_raw = (ctypes.c_long * len(_LAY_NAMES))()
+_lib.sa_layout(_raw, len(_LAY_NAMES))
+L = dict(zip(_LAY_NAMES, _raw))
+_ID = f"S{L['idlen']}"
+
+
+def _dtype(size, fields):
+    names, formats, offsets = zip(*fields)
+    return np.dtype({"names": list(names), "formats": list(formats),
+                     "offsets": list(offsets), "itemsize": size})
+
+
+FRAME_DTYPE = _dtype(L["msg_size"], [
+    ("ID",     _ID,  L["msg_id"]),
+    ("DLC",    "i4", L["msg_dlc"]),
+    ("txTime", "f4", L["msg_txtime"]),
+    ("stamp",  "f8", L["msg_stamp"])])
+
+CANDIDATE_DTYPE = _dtype(L["msg_size"], [
+    ("ID",          _ID,  L["msg_id"]),
+    ("periodicity", "f4", L["msg_period"]),
+    ("count",       "i4", L["msg_count"]),
+    ("atkWinLen",   "i4", L["msg_atkwinlen"]),
+    ("readCount",   "i4", L["msg_readcount"]),
+    ("skipLimit",   "i4", L["msg_skiplimit"]),
+    ("instances",   "u8", L["msg_instances"]),
+    ("pattern",     "u8", L["msg_pattern"])])
+
+INSTANCE_DTYPE = _dtype(L["ins_size"], [
+    ("index",       "i4", L["ins_index"]),
+    ("atkWinLen",   "i4", L["ins_atkwinlen"]),
+    ("atkWinCount", "i4", L["ins_atkwincount"]),
+    ("attackable",  "i4", L["ins_attackable"]),
+    ("atkWin",      "u8", L["ins_atkwin"]),
+    ("insWin",      "u8", L["ins_inswin"])])
+
+HYPER_DTYPE = _dtype(L["hyp_size"], [
+    ("ID",          _ID,  L["hyp_id"]),
+    ("hyper_idx",   "i4", L["hyp_idx"]),
+    ("n_frames",    "i4", L["hyp_nframes"]),
+    ("mean_gap_ms", "f8", L["hyp_meangap"]),
+    ("std_gap_ms",  "f8", L["hyp_stdgap"]),
+    ("util_bits",     "i8", L["hyp_utilbits"]),
+    ("byte_entropy",  "f8", L["hyp_entropy"]),
+    ("bit_flip_rate", "f8", L["hyp_fliprate"]),
+    ("const_mask",    "u4", L["hyp_constmask"])])
+
+
+# ──────────────────────────────────────────────────────────────────────────
+class _Owner:
+    """Native allocation; released when no view refers to it any more."""
+    def __init__(self, addr, release):
+        self.addr, self._release = addr, release
+
+    def __del__(self):
+        if self.addr:
+            self._release(self.addr)
+            self.addr = None
+
+
+def _view(addr, n, dtype, owner):
+    """n records of dtype at addr, without copying; keeps owner alive."""
+    if not addr or n <= 0:
+        return np.empty(0, dtype)
+    buf = (ctypes.c_char * (n * dtype.itemsize)).from_address(addr)
+    buf._owner = owner
+    return np.frombuffer(buf, dtype=dtype)
+
+
+def _ids(ids):
+    return (ctypes.c_char_p * len(ids))(*[str(i).encode() for i in ids])
+
+
+# ──────────────────────────────────────────────────────────────────────────
+def set_params(h=None, min_atk_win_len=None, min_dlc=None, bus_speed=None):
+    """Analyser globals (hyper-period s, minAtkWinLen bits, minDlc, kbps)."""
+    for name, ctype, val in (("h", _int, h), ("minAtkWinLen", _int, min_atk_win_len),
+                             ("minDlc", _int, min_dlc),
+                             ("busSpeed", ctypes.c_float, bus_speed)):
+        if val is not None:
+            ctype.in_dll(_lib, name).value = val
+
+
+def load_frames(paths, offsets=None, payload=False):
+    """Read one or more CAN log CSVs, merged by timestamp (per-file offsets in s).
+    payload=True also returns the packed D0..D7 column."""
+    if isinstance(paths, (str, os.PathLike)):
+        paths = [paths]
+    cpaths = (ctypes.c_char_p * len(paths))(*[os.fsencode(p) for p in paths])
+    coff   = (ctypes.c_double * len(paths))(*offsets) if offsets is not None else None
+    out, pay = _vp(), _vp()
+    n = _lib.sa_load(cpaths, coff, len(paths), ctypes.byref(out),
+                     ctypes.byref(pay) if payload else None)
+    if n < 0:
+        raise OSError(f"cannot open {paths}")
+    frames = _view(out.value, n, FRAME_DTYPE, _Owner(out.value, _lib.sa_free))
+    if not payload:
+        return frames
+    return frames, _view(pay.value, n, np.dtype("=u8"), _Owner(pay.value, _lib.sa_free))
+
+
+class Analysis:
+    """Candidate table of one analysis pass; windows are read on demand."""
+    def __init__(self, addr, n):
+        self._owner  = _Owner(addr, lambda a: _lib.sa_free_candidates(a, n))
+        self.candidates = _view(addr, n, CANDIDATE_DTYPE, self._owner)
+
+    def instances(self, i):
+        c = self.candidates[i]
+        return _view(int(c["instances"]), int(c["count"]), INSTANCE_DTYPE, self._owner)
+
+    def _window(self, i, j, field):
+        ins = self.instances(i)[j]
+        return _view(int(ins[field]), int(ins["atkWinCount"]), np.dtype("i4"), self._owner)
+
+    def atk_win(self, i, j):
+        return self._window(i, j, "atkWin")
+
+    def ins_win(self, i, j):
+        return self._window(i, j, "insWin")
+
+
+def analyze(frames, ids, periods, skips=None):
+    """One pass of the attack-window analysis (round 0 of sched_attack)."""
+    frames = np.require(frames, FRAME_DTYPE, ["C"])
+    n      = len(ids)
+    cper   = (ctypes.c_float * n)(*periods)
+    cskip  = (_int * n)(*skips) if skips is not None else None
+    addr   = _lib.sa_analyze(frames.ctypes.data, len(frames), _ids(ids), cper, cskip, n)
+    return Analysis(addr, n)
+
+
+def hyper_features(frames, H=5.0, payload=None):
+    """Per-ID, per-hyper-period timing (and payload) features, ordered by
+    ID then hyper_idx."""
+    frames = np.require(frames, FRAME_DTYPE, ["C"])
+    if payload is not None:
+        payload = np.require(payload, np.dtype("=u8"), ["C"])
+        if len(payload) != len(frames):
+            raise ValueError("payload and frames differ in length")
+    out    = _vp()
+    n = _lib.sa_hyper_features(frames.ctypes.data,
+                               payload.ctypes.data if payload is not None else None,
+                               len(frames), H, ctypes.byref(out))
+    return _view(out.value, n, HYPER_DTYPE, _Owner(out.value, _lib.sa_free))
+
+
+def hyper_frame(frames, H=5.0, payload=None):
+    """hyper_features() as a DataFrame shaped like otids_hyper_dataset.csv."""
+    import pandas as pd
+    df = pd.DataFrame(hyper_features(frames, H, payload))
+    df.insert(0, "Identifier", df.pop("ID").str.decode("ascii")
+                                 .str.replace("^0[xX]", "", regex=True)
+                                 .str.upper().str.zfill(4))
+    return df
+
+
+# ──────────────────────────────────────────────────────────────────────────
+# results file written by sched_attack (SaveResults): header, then one
+# 8-byte aligned column after another, host byte order; a candidate's
+# rows are ranked by atkWinLen, `instance` is each row's slot
+_RES_MAGIC = 0x32525741                                   # "AWR2"
+_RES_HDR   = np.dtype([("magic", "=u4"), ("nCand", "=i4"), ("nIns", "=i8"),
+                       ("nWin", "=i8"), ("h", "=i4"), ("minAtkWinLen", "=i4"),
+                       ("rounds", "=i4"), ("pad", "=i4"), ("colOff", "=i8", (11,))])
+
+
+class Results:
+    """Memory-mapped final_candidates.awr; columns are np.memmap slices."""
+    def __init__(self, path):
+        mm = np.memmap(path, np.uint8, "r")
+        hd = mm[:_RES_HDR.itemsize].view(_RES_HDR)[0]
+        if hd["magic"] != _RES_MAGIC:
+            raise ValueError(f"{path}: not a results file")
+        n, nIns, nWin = int(hd["nCand"]), int(hd["nIns"]), int(hd["nWin"])
+        off = [int(o) for o in hd["colOff"]]
+        self.h, self.min_atk_win_len, self.rounds = (int(hd["h"]),
+                                                     int(hd["minAtkWinLen"]),
+                                                     int(hd["rounds"]))
+
+        def col(k, dtype, count):
+            dtype = np.dtype(dtype)
+            return mm[off[k]:off[k] + count * dtype.itemsize].view(dtype)
+
+        self.ID          = col(0, _ID, n)
+        self.periodicity = col(1, "=f4", n)
+        self.first       = col(2, "=i8", n + 1)
+        self.candidate   = col(3, "=i4", nIns)
+        self.instance    = col(4, "=i4", nIns)
+        self.attackable  = col(5, "u1", nIns)
+        self.atkWinLen   = col(6, "=i4", nIns)
+        self.atkWinCount = col(7, "=i4", nIns)
+        self.winOff      = col(8, "=i8", nIns + 1)
+        self.atkWin      = col(9, "=i4", nWin)
+        self.insWin      = col(10, "=i4", nWin)
+
+    def __len__(self):
+        return len(self.ID)
+
+    def __getitem__(self, i):
+        r = slice(int(self.first[i]), int(self.first[i + 1]))
+        return {"ID": self.ID[i].decode(), "periodicity": float(self.periodicity[i]),
+                "instance": self.instance[r], "attackable": self.attackable[r],
+                "atkWinLen": self.atkWinLen[r], "atkWinCount": self.atkWinCount[r]}
+
+    def windows(self, i, j):
+        r = int(self.first[i]) + j
+        w = slice(int(self.winOff[r]), int(self.winOff[r + 1]))
+        return self.atkWin[w], self.insWin[w]